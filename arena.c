@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+#include "cJSON.h"
+
+// Arène qui reçoit les allocations de cJSON du thread, NULL hors d'un arenaBegin
+static __thread Arena *active_arena = NULL;
+
+/**
+ ** Prepares an empty arena. No memory is allocated until the first allocation.
+ * @param arena (Arena*) - The arena.
+ * @returns void
+ */
+void arenaInit(Arena *arena)
+{
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+/**
+ ** Allocates memory from an arena, aligned for any type.
+ * @param arena (Arena*) - The arena.
+ * @param size (size_t) - The number of bytes.
+ * @returns void* - The memory, or NULL if memory is exhausted.
+ */
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->current;
+
+    if (block == NULL || block->capacity - block->used < size)
+    {
+        // Allocations bigger than a block get a block of their own
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+        block = malloc(sizeof(ArenaBlock) + capacity);
+        if (block == NULL)
+            return NULL;
+
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+        if (arena->current != NULL)
+            arena->current->next = block;
+        else
+            arena->first = block;
+        arena->current = block;
+    }
+
+    void *pointer = block->data + block->used;
+
+    block->used += size;
+    return pointer;
+}
+
+/**
+ ** Tells whether a pointer was allocated from an arena. Walks the blocks: meant for rare frees.
+ * @param arena (const Arena*) - The arena.
+ * @param pointer (const void*) - The pointer.
+ * @returns int - 1 if the arena owns the pointer, 0 otherwise.
+ */
+int arenaOwns(const Arena *arena, const void *pointer)
+{
+    uintptr_t address = (uintptr_t)pointer;
+
+    for (const ArenaBlock *block = arena->first; block != NULL; block = block->next)
+    {
+        if (address >= (uintptr_t)block->data && address < (uintptr_t)block->data + block->capacity)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ ** Releases every allocation at once, keeping the first block for the next use.
+ * @param arena (Arena*) - The arena.
+ * @returns void
+ */
+void arenaReset(Arena *arena)
+{
+    if (arena->first == NULL)
+        return;
+
+    ArenaBlock *block = arena->first->next;
+
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+
+        free(block);
+        block = next;
+    }
+    arena->first->next = NULL;
+    arena->first->used = 0;
+    arena->current = arena->first;
+}
+
+/**
+ ** Releases an arena and all its blocks.
+ * @param arena (Arena*) - The arena.
+ * @returns void
+ */
+void arenaFree(Arena *arena)
+{
+    arenaReset(arena);
+    free(arena->first);
+    arenaInit(arena);
+}
+
+/**
+ ** cJSON allocation hook: the active arena of the thread, or malloc.
+ * @param size (size_t) - The number of bytes.
+ * @returns void* - The memory.
+ */
+static void *jsonAlloc(size_t size)
+{
+    return active_arena != NULL ? arenaAlloc(active_arena, size) : malloc(size);
+}
+
+/**
+ ** cJSON release hook: memory of the active arena is released with it, the rest with free.
+ * @param pointer (void*) - The memory.
+ * @returns void
+ */
+static void jsonFree(void *pointer)
+{
+    if (active_arena != NULL && arenaOwns(active_arena, pointer))
+        return;
+    free(pointer);
+}
+
+/**
+ ** Routes cJSON allocations through the arena hooks. Call once, before other threads use cJSON.
+ * Without an active arena, the hooks behave like malloc and free.
+ * @returns void
+ */
+void arenaInstallJsonHooks(void)
+{
+    cJSON_Hooks hooks = {jsonAlloc, jsonFree};
+
+    cJSON_InitHooks(&hooks);
+}
+
+/**
+ ** Makes an arena receive the cJSON allocations of the calling thread.
+ * @param arena (Arena*) - The arena.
+ * @returns void
+ */
+void arenaBegin(Arena *arena)
+{
+    active_arena = arena;
+}
+
+/**
+ ** Returns the calling thread to malloc for cJSON allocations.
+ * @returns void
+ */
+void arenaEnd(void)
+{
+    active_arena = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t capacity;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+} ArenaBlock;
+
+/*
+ * Allocateur par blocs: chaque allocation avance un pointeur dans le bloc courant, rien n'est
+ * libéré individuellement et tout est rendu d'un coup (arenaReset, arenaFree).
+ * Entre arenaBegin et arenaEnd, les allocations de cJSON du thread appelant passent par l'arène
+ * (arenaInstallJsonHooks doit avoir été appelé au démarrage): un parsing ou une impression
+ * complète coûte quelques malloc de ARENA_BLOCK_SIZE au lieu d'un par noeud et par chaîne.
+ * Ce que cJSON alloue dans ce cadre doit rester dedans: ni cJSON_Delete ni free après arenaEnd.
+ */
+typedef struct arena
+{
+    ArenaBlock *first;
+    ArenaBlock *current;
+} Arena;
+
+void arenaInit(Arena *arena);
+void *arenaAlloc(Arena *arena, size_t size);
+int arenaOwns(const Arena *arena, const void *pointer);
+void arenaReset(Arena *arena);
+void arenaFree(Arena *arena);
+
+void arenaInstallJsonHooks(void);
+void arenaBegin(Arena *arena);
+void arenaEnd(void);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bitset.h"
+
+/*
+ * Mesure le calcul de l'audience d'une diffusion pour 100 000 sessions: intersection des membres
+ * d'un salon et des sessions ouvertes, puis parcours du résultat. Compare une boucle scalaire
+ * (non vectorisée), les combinaisons SIMD de bitset.c, et la forme précédente des salons: une
+ * liste de membres dont on teste la session un par un.
+ * Vérifie aussi que les trois calculs donnent la même audience.
+ * Utilisation: ./bench/bitset_bench
+ */
+
+#define SESSIONS 100000
+#define ITERATIONS 20000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Intersection mot à mot sans vectorisation, pour mesurer l'apport de SSE2/AVX2
+__attribute__((optimize("no-tree-vectorize")))
+static void scalarAnd(Bitset *result, const Bitset *a, const Bitset *b)
+{
+    for (size_t i = 0; i < result->word_count; i++)
+        result->words[i] = a->words[i] & b->words[i];
+}
+
+/**
+ ** Builds a random set of sessions.
+ * @param set (Bitset*) - The set to fill, already initialized.
+ * @param percent (int) - The share of sessions in the set.
+ * @param list (int*) - Receives the members in order; may be NULL.
+ * @returns size_t - The number of members.
+ */
+static size_t fill(Bitset *set, int percent, int *list)
+{
+    size_t count = 0;
+
+    for (int i = 0; i < SESSIONS; i++)
+    {
+        if (rand() % 100 < percent)
+        {
+            bitsetSet(set, (size_t)i);
+            if (list != NULL)
+                list[count] = i;
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ ** Visits every bit of an audience with find-first-set.
+ * @param audience (const Bitset*) - The audience.
+ * @returns long - The sum of the visited sessions.
+ */
+static long visit(const Bitset *audience)
+{
+    long sum = 0;
+
+    for (long fd = bitsetNext(audience, 0); fd != -1; fd = bitsetNext(audience, (size_t)fd + 1))
+        sum += fd;
+    return sum;
+}
+
+/**
+ ** Measures the computation of an audience.
+ * @param mode (int) - 0 for the member list, 1 for the scalar intersection, 2 for bitsetAnd.
+ * @param iterate (int) - 1 to also visit the audience.
+ * @param checksum (long*) - Receives the sum of the audience of the last iteration.
+ * @returns double - µs per audience.
+ */
+static double bench(int mode, int iterate, Bitset *audience, const Bitset *members, const Bitset *online,
+                    const int *list, size_t list_count, long *checksum)
+{
+    double start = now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        long sum = 0;
+
+        if (mode == 0)
+        {
+            for (size_t j = 0; j < list_count; j++)
+            {
+                if (bitsetTest(online, (size_t)list[j]))
+                    sum += list[j];
+            }
+        }
+        else
+        {
+            if (mode == 1)
+                scalarAnd(audience, members, online);
+            else
+                bitsetAnd(audience, members, online);
+            if (iterate)
+                sum = visit(audience);
+        }
+        *checksum = sum;
+    }
+    return (now() - start) * 1e6 / ITERATIONS;
+}
+
+int main(void)
+{
+    Bitset members;
+    Bitset online;
+    Bitset audience;
+    int *list = malloc(SESSIONS * sizeof(int));
+
+    if (list == NULL || bitsetInit(&members, SESSIONS) == -1 || bitsetInit(&online, SESSIONS) == -1 ||
+        bitsetInit(&audience, SESSIONS) == -1)
+        return 1;
+
+    srand(42);
+    size_t list_count = fill(&members, 30, list);
+    fill(&online, 80, NULL);
+
+    long expected = 0;
+    long scalar = 0;
+    long simd = 0;
+    double list_us = bench(0, 1, &audience, &members, &online, list, list_count, &expected);
+    double scalar_and_us = bench(1, 0, &audience, &members, &online, list, list_count, &scalar);
+    double simd_and_us = bench(2, 0, &audience, &members, &online, list, list_count, &simd);
+    double scalar_us = bench(1, 1, &audience, &members, &online, list, list_count, &scalar);
+    double simd_us = bench(2, 1, &audience, &members, &online, list, list_count, &simd);
+
+    printf("%zu membres sur %d sessions, %zu dans l'audience\n", list_count, SESSIONS, bitsetCount(&audience));
+    printf("%-34s %12s\n", "opération", "µs");
+    printf("%-34s %12.2f\n", "liste de membres, test en ligne", list_us);
+    printf("%-34s %12.2f\n", "AND scalaire", scalar_and_us);
+    printf("%-34s %12.2f\n", "AND SIMD", simd_and_us);
+    printf("%-34s %12.2f\n", "AND scalaire et parcours", scalar_us);
+    printf("%-34s %12.2f\n", "AND SIMD et parcours", simd_us);
+
+    if (scalar != expected || simd != expected)
+    {
+        printf("ERREUR: audiences différentes (%ld, %ld, %ld)\n", expected, scalar, simd);
+        return 1;
+    }
+    bitsetFree(&members);
+    bitsetFree(&online);
+    bitsetFree(&audience);
+    free(list);
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "commandline.h"
+
+/*
+ * Compare l'ancienne reconnaissance des commandes (suite de strncasecmp sur des préfixes, puis
+ * sscanf des arguments dans des tampons) et la table à hachage parfait avec découpage sans copie.
+ * Vérifie aussi que chaque commande est reconnue exactement.
+ * Utilisation: ./bench/command_bench
+ */
+
+#define ITERATIONS 10000000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// parseCommand tel qu'il était avant la table: reconnaît les préfixes ("@helpful" donne HELP)
+static Command legacyParseCommand(const char *msg)
+{
+    if (strncasecmp(msg, "@command", 8) == 0)
+        return COMMAND;
+    if (strncasecmp(msg, "@help", 5) == 0)
+        return HELP;
+    if (strncasecmp(msg, "@ping", 5) == 0)
+        return PING;
+    if (strncasecmp(msg, "@msg", 4) == 0)
+        return MSG;
+    if (strncasecmp(msg, "@connect", 8) == 0)
+        return CONNECT;
+    if (strncasecmp(msg, "@credits", 8) == 0)
+        return CREDITS;
+    if (strncasecmp(msg, "@shutdown", 9) == 0)
+        return SHUTDOWN;
+    if (strncasecmp(msg, "@create", 7) == 0)
+        return CREATE;
+    if (strncasecmp(msg, "@join", 5) == 0)
+        return JOIN;
+    if (strncasecmp(msg, "@leave", 6) == 0)
+        return LEAVE;
+    if (strncasecmp(msg, "@upload", 7) == 0)
+        return UPLOAD;
+    if (strncasecmp(msg, "@download", 9) == 0)
+        return DOWNLOAD;
+    if (strncasecmp(msg, "@stats", 6) == 0)
+        return STATS;
+    if (strncasecmp(msg, "@password", 9) == 0)
+        return PASSWORD;
+    if (strncasecmp(msg, "@export", 7) == 0)
+        return EXPORT;
+    return UNKNOWN;
+}
+
+typedef struct sample
+{
+    const char *line;
+    Command expected;
+} Sample;
+
+static const Sample samples[] = {
+    {"@command", COMMAND},
+    {"@help", HELP},
+    {"@PING", PING},
+    {"@msg bob salut", MSG},
+    {"@connect alice secret", CONNECT},
+    {"@credits", CREDITS},
+    {"@shutdown", SHUTDOWN},
+    {"@create salon", CREATE},
+    {"@join salon", JOIN},
+    {"@leave salon", LEAVE},
+    {"@upload photo.png 1024", UPLOAD},
+    {"@download photo.png", DOWNLOAD},
+    {"@Stats", STATS},
+    {"@password ancien nouveau", PASSWORD},
+    {"@export", EXPORT},
+    {"@helpful", UNKNOWN},
+    {"@pingpong", UNKNOWN},
+    {"@", UNKNOWN},
+    {"bonjour tout le monde", UNKNOWN},
+};
+
+#define SAMPLE_COUNT (sizeof(samples) / sizeof(samples[0]))
+
+/**
+ ** Checks that every sample line is recognized as its expected command.
+ * @returns int - The number of mismatches.
+ */
+static int checkSamples(void)
+{
+    int errors = 0;
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++)
+    {
+        Command parsed = parseCommand(samples[i].line);
+
+        if (parsed != samples[i].expected)
+        {
+            printf("ERREUR: \"%s\" reconnu comme %d au lieu de %d\n", samples[i].line, parsed, samples[i].expected);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/**
+ ** Measures the recognition of the command word over all the sample lines.
+ * @param parse (Command (*)(const char*)) - The parser.
+ * @param checksum (long*) - Accumulates the results, so that they are not optimized out.
+ * @returns double - ns per line.
+ */
+static double benchDispatch(Command (*parse)(const char *), long *checksum)
+{
+    double start = now();
+
+    for (long i = 0; i < ITERATIONS; i++)
+        *checksum += parse(samples[i % SAMPLE_COUNT].line);
+    return (now() - start) * 1e9 / ITERATIONS;
+}
+
+/**
+ ** Measures the whole parsing of "@connect" and "@msg" lines, command and arguments, as executeCommand does it.
+ * @param legacy (int) - 1 for strncasecmp and sscanf, 0 for the table and the views.
+ * @param checksum (long*) - Accumulates the argument lengths.
+ * @returns double - ns per line.
+ */
+static double benchArguments(int legacy, long *checksum)
+{
+    char lines[2][64] = {"@connect alice secret", "@msg bob salut, comment vas-tu ?"};
+    double start = now();
+
+    for (long i = 0; i < ITERATIONS; i++)
+    {
+        char *msg = lines[i & 1];
+
+        if (legacy)
+        {
+            char first[32];
+            char second[1024];
+
+            if (legacyParseCommand(msg) == CONNECT)
+                sscanf(msg, "@connect %s %s", first, second);
+            else
+                sscanf(msg, "@msg %s %[^\n]", first, second);
+            *checksum += strlen(first) + strlen(second);
+        }
+        else
+        {
+            CommandLine line;
+            StringView first;
+            StringView second;
+
+            Command command = commandLineParse(&line, msg);
+
+            commandLineNext(&line, &first);
+            if (command == CONNECT)
+                commandLineNext(&line, &second);
+            else
+                second = commandLineRest(&line);
+            *checksum += first.length + second.length;
+        }
+    }
+    return (now() - start) * 1e9 / ITERATIONS;
+}
+
+int main(void)
+{
+    long checksum = 0;
+    int errors = checkSamples();
+
+    printf("%-34s %12s %12s\n", "opération", "ancien ns", "table ns");
+    printf("%-34s %12.1f %12.1f\n", "reconnaissance de la commande", benchDispatch(legacyParseCommand, &checksum), benchDispatch(parseCommand, &checksum));
+    printf("%-34s %12.1f %12.1f\n", "commande et arguments", benchArguments(1, &checksum), benchArguments(0, &checksum));
+    return errors != 0 || checksum == 0;
+}
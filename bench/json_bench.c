@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "cJSON.h"
+#include "jsonstream.h"
+
+/*
+ * Compare le chargement et la sauvegarde d'un users.json de N utilisateurs avec les allocations
+ * de cJSON faites par malloc (une par noeud et par chaîne) ou dans une arène.
+ * Utilisation: ./bench/json_bench [utilisateurs] [fichier]
+ */
+
+static size_t checksum = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ ** Reads the fields of one user, as the loader of the server does.
+ * @param item (const cJSON*) - The user object.
+ * @param arg (void*) - Unused.
+ * @returns int - Always 0.
+ */
+static int readUser(const cJSON *item, void *arg)
+{
+    (void)arg;
+    checksum += strlen(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "username")));
+    checksum += strlen(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "password")));
+    return 0;
+}
+
+/**
+ ** Builds the users array and prints it to a file, as saveUsersToJson does.
+ * @param path (const char*) - The file.
+ * @param count (long) - Number of users.
+ * @param arena (Arena*) - The arena receiving the allocations, or NULL for malloc.
+ * @returns double - Elapsed seconds.
+ */
+static double save(const char *path, long count, Arena *arena)
+{
+    double start = now();
+
+    if (arena != NULL)
+        arenaBegin(arena);
+
+    cJSON *json = cJSON_CreateArray();
+    char buffer[50];
+
+    for (long i = 0; i < count; i++)
+    {
+        cJSON *user = cJSON_CreateObject();
+
+        snprintf(buffer, sizeof(buffer), "user%ld", i);
+        cJSON_AddStringToObject(user, "username", buffer);
+        snprintf(buffer, sizeof(buffer), "pw%ld", i);
+        cJSON_AddStringToObject(user, "password", buffer);
+        cJSON_AddStringToObject(user, "role", i == 0 ? "ADMIN" : "USER");
+        cJSON_AddItemToArray(json, user);
+    }
+
+    char *data = cJSON_Print(json);
+    FILE *file = fopen(path, "w");
+
+    fputs(data, file);
+    fclose(file);
+
+    if (arena != NULL)
+    {
+        arenaEnd();
+        arenaFree(arena);
+    }
+    else
+    {
+        free(data);
+        cJSON_Delete(json);
+    }
+    return now() - start;
+}
+
+/**
+ ** Reads the whole file and parses it into one tree, as the loader did before streaming.
+ * @param path (const char*) - The file.
+ * @param arena (Arena*) - The arena receiving the allocations, or NULL for malloc.
+ * @returns double - Elapsed seconds.
+ */
+static double loadTree(const char *path, Arena *arena)
+{
+    double start = now();
+    FILE *file = fopen(path, "r");
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    char *data = malloc(size + 1);
+
+    rewind(file);
+    if (fread(data, 1, size, file) != (size_t)size)
+        size = 0;
+    data[size] = '\0';
+    fclose(file);
+
+    if (arena != NULL)
+        arenaBegin(arena);
+
+    cJSON *json = cJSON_Parse(data);
+    cJSON *item;
+
+    cJSON_ArrayForEach(item, json)
+        readUser(item, NULL);
+
+    if (arena != NULL)
+    {
+        arenaEnd();
+        arenaFree(arena);
+    }
+    else
+    {
+        cJSON_Delete(json);
+    }
+    free(data);
+    return now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    const char *path = argc > 2 ? argv[2] : "/tmp/users_bench.json";
+    Arena arena;
+
+    if (count <= 0)
+        count = 1000000;
+
+    arenaInstallJsonHooks();
+    arenaInit(&arena);
+
+    printf("%ld utilisateurs, %s\n", count, path);
+    printf("%-28s %10s\n", "opération", "secondes");
+    printf("%-28s %10.3f\n", "sauvegarde malloc", save(path, count, NULL));
+    printf("%-28s %10.3f\n", "sauvegarde arène", save(path, count, &arena));
+    printf("%-28s %10.3f\n", "chargement arbre malloc", loadTree(path, NULL));
+    printf("%-28s %10.3f\n", "chargement arbre arène", loadTree(path, &arena));
+
+    double start = now();
+    long streamed = jsonStreamArray(path, readUser, NULL);
+    printf("%-28s %10.3f\n", "chargement flux arène", now() - start);
+
+    return streamed == count && checksum > 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "registry.h"
+
+/*
+ * Compare la recherche par pseudo dans l'ancienne liste chaînée (parcours sous mutex)
+ * et dans le registre à adressage ouvert (lecteurs sans verrou), pour des tailles croissantes.
+ * Utilisation: ./bench/registry_bench [lecteurs]
+ */
+
+#define READER_LOOKUPS 1000000
+
+// Ancienne représentation: liste simplement chaînée protégée par un mutex
+typedef struct list_user
+{
+    User user;
+    struct list_user *next;
+} ListUser;
+
+static ListUser *list_head = NULL;
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Registry registry = REGISTRY_INITIALIZER;
+static User *users = NULL;
+static size_t user_count = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static User *listFind(const char *name)
+{
+    pthread_mutex_lock(&list_mutex);
+    for (ListUser *current = list_head; current != NULL; current = current->next)
+    {
+        if (strcmp(current->user.name, name) == 0)
+        {
+            pthread_mutex_unlock(&list_mutex);
+            return &current->user;
+        }
+    }
+    pthread_mutex_unlock(&list_mutex);
+    return NULL;
+}
+
+static void *registryReader(void *arg)
+{
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t found = 0;
+
+    for (int i = 0; i < READER_LOOKUPS; i++)
+    {
+        if (registryFind(&registry, users[rand_r(&seed) % user_count].name) != NULL)
+            found++;
+    }
+    return (void *)found;
+}
+
+static void *listReader(void *arg)
+{
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t found = 0;
+
+    for (int i = 0; i < READER_LOOKUPS / 1000; i++)
+    {
+        if (listFind(users[rand_r(&seed) % user_count].name) != NULL)
+            found++;
+    }
+    return (void *)found;
+}
+
+/**
+ ** Runs the same lookup function on several threads and returns the time per lookup.
+ * @param reader (void *(*)(void*)) - The reader thread.
+ * @param threads (int) - Number of threads.
+ * @param lookups (int) - Lookups done by each thread.
+ * @returns double - Wall-clock nanoseconds per lookup, all threads together.
+ */
+static double runReaders(void *(*reader)(void *), int threads, int lookups)
+{
+    pthread_t ids[64];
+    double start = now();
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, reader, (void *)(size_t)(i + 1));
+    for (int i = 0; i < threads; i++)
+    {
+        void *found;
+        pthread_join(ids[i], &found);
+
+        if ((size_t)found != (size_t)lookups)
+            fprintf(stderr, "recherches manquées: %zu/%d\n", (size_t)found, lookups);
+    }
+    return (now() - start) * 1e9 / ((double)lookups * threads);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    size_t sizes[] = {1000, 10000, 100000, 1000000};
+
+    if (threads < 1 || threads > 64)
+        threads = 4;
+
+    char shared_title[32];
+    snprintf(shared_title, sizeof(shared_title), "hash ns (x%d)", threads);
+    printf("%10s %14s %14s %16s %14s\n", "users", "insert ns", "hash ns", shared_title, "list ns");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        user_count = sizes[s];
+        users = calloc(user_count, sizeof(User));
+        ListUser *nodes = calloc(user_count, sizeof(ListUser));
+
+        for (size_t i = 0; i < user_count; i++)
+        {
+            snprintf(users[i].name, sizeof(users[i].name), "user%zu", i);
+            nodes[i].user = users[i];
+            nodes[i].next = list_head;
+            list_head = &nodes[i];
+        }
+
+        // The registry owns the users it holds: each one gets its own copy
+        User **copies = malloc(user_count * sizeof(User *));
+        for (size_t i = 0; i < user_count; i++)
+        {
+            copies[i] = malloc(sizeof(User));
+            *copies[i] = users[i];
+        }
+
+        double start = now();
+        for (size_t i = 0; i < user_count; i++)
+            registryInsert(&registry, copies[i], -1, NULL);
+        double insert = (now() - start) * 1e9 / user_count;
+
+        double single = runReaders(registryReader, 1, READER_LOOKUPS);
+        double shared = runReaders(registryReader, threads, READER_LOOKUPS);
+        double list = runReaders(listReader, 1, READER_LOOKUPS / 1000);
+
+        printf("%10zu %14.1f %14.1f %16.1f %14.1f\n", user_count, insert, single, shared, list);
+
+        registryDestroy(&registry);
+        free(copies);
+        list_head = NULL;
+        free(nodes);
+        free(users);
+    }
+    return 0;
+}
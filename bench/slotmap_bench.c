@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ChainedList.h"
+#include "slotmap.h"
+
+/*
+ * Compare la liste chaînée des clients (ChainedList) et la slot map pour les opérations
+ * d'un shard: connexion (ajout), déconnexion (retrait) et broadcast (parcours complet).
+ * Utilisation: ./bench/slotmap_bench
+ */
+
+#define CHURN_OPERATIONS 1000
+#define BROADCASTS 100
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ ** Measures a list of n clients: n accepts and disconnects on a full list, and full traversals.
+ * @param n (int) - Number of connected clients.
+ * @param results (double*) - Receives ns per accept, per disconnect and per visited client.
+ * @returns long - Checksum of the traversals, so that they are not optimized out.
+ */
+static long benchList(int n, double *results)
+{
+    List *list = calloc(1, sizeof(List));
+    long checksum = 0;
+
+    // The list is filled from the front: filling it with addLast alone would take minutes at 100k
+    for (int i = n - 1; i >= 0; i--)
+        addFirst(list, i);
+
+    unsigned int seed = 1;
+    double start = now();
+    for (int i = 0; i < CHURN_OPERATIONS; i++)
+        addLast(list, n + i);
+    results[0] = (now() - start) * 1e9 / CHURN_OPERATIONS;
+
+    start = now();
+    for (int i = 0; i < CHURN_OPERATIONS; i++)
+        removeElement(list, rand_r(&seed) % n);
+    results[1] = (now() - start) * 1e9 / CHURN_OPERATIONS;
+
+    start = now();
+    for (int b = 0; b < BROADCASTS; b++)
+    {
+        for (Node *current = list->first; current != NULL; current = current->next)
+            checksum += current->val;
+    }
+    results[2] = (now() - start) * 1e9 / ((double)BROADCASTS * list->size);
+
+    while (!isListEmpty(list))
+        removeFirst(list);
+    free(list);
+    return checksum;
+}
+
+/**
+ ** Measures a slot map of n clients with the same operations as benchList.
+ * @param n (int) - Number of connected clients.
+ * @param results (double*) - Receives ns per accept, per disconnect and per visited client.
+ * @returns long - Checksum of the traversals.
+ */
+static long benchSlotMap(int n, double *results)
+{
+    SlotMap map;
+    SlotHandle *handles = malloc((n + CHURN_OPERATIONS) * sizeof(SlotHandle));
+    long checksum = 0;
+
+    slotMapInit(&map);
+    for (int i = 0; i < n; i++)
+        handles[i] = slotMapInsert(&map, i);
+
+    unsigned int seed = 1;
+    double start = now();
+    for (int i = 0; i < CHURN_OPERATIONS; i++)
+        handles[n + i] = slotMapInsert(&map, n + i);
+    results[0] = (now() - start) * 1e9 / CHURN_OPERATIONS;
+
+    start = now();
+    for (int i = 0; i < CHURN_OPERATIONS; i++)
+        slotMapRemove(&map, handles[rand_r(&seed) % n]);
+    results[1] = (now() - start) * 1e9 / CHURN_OPERATIONS;
+
+    start = now();
+    for (int b = 0; b < BROADCASTS; b++)
+    {
+        for (size_t i = 0; i < map.count; i++)
+            checksum += map.values[i];
+    }
+    results[2] = (now() - start) * 1e9 / ((double)BROADCASTS * map.count);
+
+    slotMapFree(&map);
+    free(handles);
+    return checksum;
+}
+
+int main(void)
+{
+    int sizes[] = {10000, 100000};
+    long checksum = 0;
+
+    printf("%8s %-10s %12s %14s %16s\n", "clients", "structure", "accept ns", "disconnect ns", "broadcast ns/cl");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        double list[3], map[3];
+
+        checksum += benchList(sizes[s], list);
+        checksum += benchSlotMap(sizes[s], map);
+
+        printf("%8d %-10s %12.1f %14.1f %16.2f\n", sizes[s], "list", list[0], list[1], list[2]);
+        printf("%8d %-10s %12.1f %14.1f %16.2f\n", sizes[s], "slotmap", map[0], map[1], map[2]);
+    }
+    return checksum == 0;
+}
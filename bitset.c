@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bitset.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BITSET_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/**
+ ** Allocates an empty set able to hold the bits 0 to bit_count - 1.
+ * The words are rounded up to a whole number of AVX2 registers, so that the combinations have no tail.
+ * @param set (Bitset*) - The set to initialize.
+ * @param bit_count (size_t) - The number of bits.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+int bitsetInit(Bitset *set, size_t bit_count)
+{
+    size_t word_count = (bit_count + 63) / 64;
+
+    word_count = (word_count + BITSET_WORD_ALIGN - 1) / BITSET_WORD_ALIGN * BITSET_WORD_ALIGN;
+    if (word_count == 0)
+        word_count = BITSET_WORD_ALIGN;
+
+    set->words = aligned_alloc(BITSET_WORD_ALIGN * sizeof(uint64_t), word_count * sizeof(uint64_t));
+    set->word_count = set->words != NULL ? word_count : 0;
+    if (set->words == NULL)
+        return -1;
+
+    memset(set->words, 0, word_count * sizeof(uint64_t));
+    return 0;
+}
+
+/**
+ ** Releases the words of a set.
+ * @param set (Bitset*) - The set.
+ * @returns void
+ */
+void bitsetFree(Bitset *set)
+{
+    free(set->words);
+    set->words = NULL;
+    set->word_count = 0;
+}
+
+/**
+ ** Adds a bit to a set, atomically: other bits of the same word may change concurrently.
+ * @param set (Bitset*) - The set.
+ * @param bit (size_t) - The bit, below the size of the set.
+ * @returns void
+ */
+void bitsetSet(Bitset *set, size_t bit)
+{
+    // The words stay plain integers for the vector loads: the builtins make the update atomic
+    __atomic_fetch_or(&set->words[bit / 64], (uint64_t)1 << (bit % 64), __ATOMIC_RELEASE);
+}
+
+/**
+ ** Removes a bit from a set, atomically.
+ * @param set (Bitset*) - The set.
+ * @param bit (size_t) - The bit, below the size of the set.
+ * @returns void
+ */
+void bitsetClear(Bitset *set, size_t bit)
+{
+    __atomic_fetch_and(&set->words[bit / 64], ~((uint64_t)1 << (bit % 64)), __ATOMIC_RELEASE);
+}
+
+/**
+ ** Tells whether a bit is in a set.
+ * @param set (const Bitset*) - The set.
+ * @param bit (size_t) - The bit.
+ * @returns int - 1 if it is, 0 otherwise (also when the bit is beyond the set).
+ */
+int bitsetTest(const Bitset *set, size_t bit)
+{
+    if (bit / 64 >= set->word_count)
+        return 0;
+    return (__atomic_load_n(&set->words[bit / 64], __ATOMIC_ACQUIRE) >> (bit % 64)) & 1;
+}
+
+#ifdef BITSET_SIMD_X86
+__attribute__((target("avx2")))
+static void combineAvx2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t word_count, int is_or)
+{
+    for (size_t i = 0; i < word_count; i += 4)
+    {
+        __m256i left = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i right = _mm256_loadu_si256((const __m256i *)(b + i));
+
+        _mm256_storeu_si256((__m256i *)(result + i), is_or ? _mm256_or_si256(left, right) : _mm256_and_si256(left, right));
+    }
+}
+
+static void combineSse2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t word_count, int is_or)
+{
+    for (size_t i = 0; i < word_count; i += 2)
+    {
+        __m128i left = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i right = _mm_loadu_si128((const __m128i *)(b + i));
+
+        _mm_storeu_si128((__m128i *)(result + i), is_or ? _mm_or_si128(left, right) : _mm_and_si128(left, right));
+    }
+}
+#endif
+
+/**
+ ** Combines two sets word by word, with AVX2 when the CPU has it, SSE2 otherwise.
+ * @param result (Bitset*) - Receives the combination; may be one of the operands.
+ * @param a (const Bitset*) - The first set.
+ * @param b (const Bitset*) - The second set.
+ * @param is_or (int) - 1 for the union, 0 for the intersection.
+ * @returns void
+ */
+static void combine(Bitset *result, const Bitset *a, const Bitset *b, int is_or)
+{
+    size_t word_count = result->word_count;
+
+    if (a->word_count < word_count)
+        word_count = a->word_count;
+    if (b->word_count < word_count)
+        word_count = b->word_count;
+
+#ifdef BITSET_SIMD_X86
+    // Every set has a whole number of AVX2 registers: no tail to handle
+    if (__builtin_cpu_supports("avx2"))
+        combineAvx2(result->words, a->words, b->words, word_count, is_or);
+    else
+        combineSse2(result->words, a->words, b->words, word_count, is_or);
+#else
+    for (size_t i = 0; i < word_count; i++)
+        result->words[i] = is_or ? a->words[i] | b->words[i] : a->words[i] & b->words[i];
+#endif
+
+    // Words beyond the smaller operand are empty in an intersection; a union of sets of the
+    // same domain never gets there
+    if (word_count < result->word_count)
+        memset(result->words + word_count, 0, (result->word_count - word_count) * sizeof(uint64_t));
+}
+
+/**
+ ** Computes the intersection of two sets.
+ * @param result (Bitset*) - Receives a AND b; may be a or b.
+ * @param a (const Bitset*) - The first set.
+ * @param b (const Bitset*) - The second set.
+ * @returns void
+ */
+void bitsetAnd(Bitset *result, const Bitset *a, const Bitset *b)
+{
+    combine(result, a, b, 0);
+}
+
+/**
+ ** Computes the union of two sets.
+ * @param result (Bitset*) - Receives a OR b; may be a or b.
+ * @param a (const Bitset*) - The first set.
+ * @param b (const Bitset*) - The second set.
+ * @returns void
+ */
+void bitsetOr(Bitset *result, const Bitset *a, const Bitset *b)
+{
+    combine(result, a, b, 1);
+}
+
+/**
+ ** Counts the bits of a set.
+ * @param set (const Bitset*) - The set.
+ * @returns size_t - The number of bits set.
+ */
+size_t bitsetCount(const Bitset *set)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < set->word_count; i++)
+        count += (size_t)__builtin_popcountll(set->words[i]);
+    return count;
+}
+
+/**
+ ** Finds the first bit set at or after a position.
+ * @param set (const Bitset*) - The set.
+ * @param from (size_t) - The position.
+ * @returns long - The bit, or -1 if there is none.
+ */
+long bitsetNext(const Bitset *set, size_t from)
+{
+    return bitsetNextCommon(set, set, from);
+}
+
+/**
+ ** Finds the first bit set in both sets at or after a position, without computing the intersection.
+ * @param a (const Bitset*) - The first set.
+ * @param b (const Bitset*) - The second set.
+ * @param from (size_t) - The position.
+ * @returns long - The bit, or -1 if there is none.
+ */
+long bitsetNextCommon(const Bitset *a, const Bitset *b, size_t from)
+{
+    size_t word_count = a->word_count < b->word_count ? a->word_count : b->word_count;
+    size_t index = from / 64;
+
+    if (index >= word_count)
+        return -1;
+
+    // The bits before the position are masked out of its word
+    uint64_t word = a->words[index] & b->words[index] & (~(uint64_t)0 << (from % 64));
+
+    while (word == 0)
+    {
+        if (++index == word_count)
+            return -1;
+        word = a->words[index] & b->words[index];
+    }
+    return (long)(index * 64 + (size_t)__builtin_ctzll(word));
+}
+
+/**
+ ** Returns a view of the first bits of a set, sharing its words: the combinations and the scans
+ * of the view stop there instead of at the end of the set.
+ * @param set (const Bitset*) - The set.
+ * @param bit_count (size_t) - The number of bits wanted, rounded up to a whole number of AVX2 registers.
+ * @returns Bitset - The view, never longer than the set; it must not be freed.
+ */
+Bitset bitsetPrefix(const Bitset *set, size_t bit_count)
+{
+    size_t word_count = (bit_count + 63) / 64;
+
+    word_count = (word_count + BITSET_WORD_ALIGN - 1) / BITSET_WORD_ALIGN * BITSET_WORD_ALIGN;
+    if (word_count > set->word_count)
+        word_count = set->word_count;
+
+    Bitset prefix = {set->words, word_count};
+
+    return prefix;
+}
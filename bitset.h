@@ -0,0 +1,35 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Nombre de mots de 64 bits traités ensemble par les combinaisons (un registre AVX2)
+#define BITSET_WORD_ALIGN 4
+
+/*
+ * Ensemble de descripteurs de sockets, un bit par descripteur. Les ensembles d'un même
+ * domaine (les sessions) ont la même taille, ce qui permet de les combiner mot à mot
+ * (AND/OR en SSE2 ou AVX2) puis de parcourir le résultat avec find-first-set.
+ * Un bit est posé ou retiré atomiquement, sans verrou; une lecture concurrente voit le bit
+ * avant ou après sa modification.
+ */
+typedef struct bitset
+{
+    uint64_t *words;
+    size_t word_count;
+} Bitset;
+
+int bitsetInit(Bitset *set, size_t bit_count);
+void bitsetFree(Bitset *set);
+void bitsetSet(Bitset *set, size_t bit);
+void bitsetClear(Bitset *set, size_t bit);
+int bitsetTest(const Bitset *set, size_t bit);
+void bitsetAnd(Bitset *result, const Bitset *a, const Bitset *b);
+void bitsetOr(Bitset *result, const Bitset *a, const Bitset *b);
+size_t bitsetCount(const Bitset *set);
+long bitsetNext(const Bitset *set, size_t from);
+long bitsetNextCommon(const Bitset *a, const Bitset *b, size_t from);
+Bitset bitsetPrefix(const Bitset *set, size_t bit_count);
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "buffer.h"
+
+/**
+ ** Allocates a shared buffer holding a copy of the given bytes, with one reference.
+ * @param data (const void*) - The bytes to copy.
+ * @param length (size_t) - The number of bytes.
+ * @returns MessageBuffer* - The new buffer, or NULL if out of memory.
+ */
+MessageBuffer *bufferCreate(const void *data, size_t length)
+{
+    MessageBuffer *buffer = malloc(sizeof(MessageBuffer) + length);
+
+    if (buffer == NULL)
+        return NULL;
+
+    atomic_init(&buffer->refcount, 1);
+    buffer->length = length;
+    memcpy(buffer->data, data, length);
+    return buffer;
+}
+
+/**
+ ** Formats a string into a new shared buffer, with one reference. The final '\0' is not part of the buffer.
+ * @param format (const char*) - The printf format.
+ * @returns MessageBuffer* - The new buffer, or NULL on error.
+ */
+MessageBuffer *bufferPrintf(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (length < 0)
+        return NULL;
+
+    MessageBuffer *buffer = malloc(sizeof(MessageBuffer) + length + 1);
+
+    if (buffer == NULL)
+        return NULL;
+
+    va_start(args, format);
+    vsnprintf(buffer->data, length + 1, format, args);
+    va_end(args);
+
+    atomic_init(&buffer->refcount, 1);
+    buffer->length = length;
+    return buffer;
+}
+
+/**
+ ** Adds a reference to a shared buffer.
+ * @param buffer (MessageBuffer*) - The buffer.
+ * @returns MessageBuffer* - The same buffer.
+ */
+MessageBuffer *bufferRetain(MessageBuffer *buffer)
+{
+    atomic_fetch_add_explicit(&buffer->refcount, 1, memory_order_relaxed);
+    return buffer;
+}
+
+/**
+ ** Drops a reference to a shared buffer and frees it with the last one.
+ * @param buffer (MessageBuffer*) - The buffer, may be NULL.
+ * @returns void
+ */
+void bufferRelease(MessageBuffer *buffer)
+{
+    if (buffer != NULL && atomic_fetch_sub_explicit(&buffer->refcount, 1, memory_order_acq_rel) == 1)
+        free(buffer);
+}
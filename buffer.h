@@ -0,0 +1,20 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Tampon immuable partagé entre les files d'envoi, libéré par le dernier utilisateur
+typedef struct message_buffer
+{
+    atomic_int refcount;
+    size_t length;
+    char data[];
+} MessageBuffer;
+
+MessageBuffer *bufferCreate(const void *data, size_t length);
+MessageBuffer *bufferPrintf(const char *format, ...);
+MessageBuffer *bufferRetain(MessageBuffer *buffer);
+void bufferRelease(MessageBuffer *buffer);
+
+#endif
@@ -270,6 +270,11 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
             global_hooks.deallocate(item->string);
             item->string = NULL;
         }
+        if (item->index != NULL)
+        {
+            global_hooks.deallocate(item->index);
+            item->index = NULL;
+        }
         global_hooks.deallocate(item);
         item = next;
     }
@@ -815,6 +820,221 @@ fail:
     return 0;
 }
 
+/* SIMD scanning of strings and whitespace.
+ * Each scan returns the length of the prefix of input[0..length) made of bytes that need no
+ * attention; the callers then carry on with the original byte-by-byte code, so the result is
+ * the same whichever variant runs. SSE2 is used when the compiler targets it, AVX2 when the
+ * CPU reports it at runtime. Define CJSON_NO_SIMD to keep only the scalar code. */
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(CJSON_NO_SIMD)
+#define CJSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static size_t scan_whitespace_scalar(const unsigned char *input, size_t length)
+{
+    size_t offset = 0;
+    while ((offset < length) && (input[offset] <= 32))
+    {
+        offset++;
+    }
+    return offset;
+}
+
+static size_t scan_string_scalar(const unsigned char *input, size_t length)
+{
+    size_t offset = 0;
+    while ((offset < length) && (input[offset] != '\"') && (input[offset] != '\\'))
+    {
+        offset++;
+    }
+    return offset;
+}
+
+static size_t scan_unescaped_scalar(const unsigned char *input, size_t length)
+{
+    size_t offset = 0;
+    while ((offset < length) && (input[offset] > 31) && (input[offset] != '\"') && (input[offset] != '\\'))
+    {
+        offset++;
+    }
+    return offset;
+}
+
+#ifdef CJSON_SIMD_X86
+/* bytes <= limit, compared unsigned: max(byte, limit) == limit */
+#define CJSON_SSE2_AT_MOST(chunk, limit) _mm_cmpeq_epi8(_mm_max_epu8((chunk), (limit)), (limit))
+#define CJSON_AVX2_AT_MOST(chunk, limit) _mm256_cmpeq_epi8(_mm256_max_epu8((chunk), (limit)), (limit))
+
+static size_t scan_whitespace_sse2(const unsigned char *input, size_t length)
+{
+    const __m128i space = _mm_set1_epi8(32);
+    size_t offset = 0;
+    for (; (offset + 16) <= length; offset += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + offset));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(CJSON_SSE2_AT_MOST(chunk, space));
+        if (mask != 0xFFFF)
+        {
+            return offset + (size_t)__builtin_ctz(~mask);
+        }
+    }
+    return offset + scan_whitespace_scalar(input + offset, length - offset);
+}
+
+static size_t scan_string_sse2(const unsigned char *input, size_t length)
+{
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    size_t offset = 0;
+    for (; (offset + 16) <= length; offset += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + offset));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask != 0)
+        {
+            return offset + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return offset + scan_string_scalar(input + offset, length - offset);
+}
+
+static size_t scan_unescaped_sse2(const unsigned char *input, size_t length)
+{
+    const __m128i control = _mm_set1_epi8(31);
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    size_t offset = 0;
+    for (; (offset + 16) <= length; offset += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + offset));
+        __m128i special = _mm_or_si128(CJSON_SSE2_AT_MOST(chunk, control), _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+            return offset + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return offset + scan_unescaped_scalar(input + offset, length - offset);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_whitespace_avx2(const unsigned char *input, size_t length)
+{
+    const __m256i space = _mm256_set1_epi8(32);
+    size_t offset = 0;
+    for (; (offset + 32) <= length; offset += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(input + offset));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(CJSON_AVX2_AT_MOST(chunk, space));
+        if (mask != 0xFFFFFFFFu)
+        {
+            return offset + (size_t)__builtin_ctz(~mask);
+        }
+    }
+    return offset + scan_whitespace_sse2(input + offset, length - offset);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_string_avx2(const unsigned char *input, size_t length)
+{
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    size_t offset = 0;
+    for (; (offset + 32) <= length; offset += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(input + offset));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)));
+        if (mask != 0)
+        {
+            return offset + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return offset + scan_string_sse2(input + offset, length - offset);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_unescaped_avx2(const unsigned char *input, size_t length)
+{
+    const __m256i control = _mm256_set1_epi8(31);
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    size_t offset = 0;
+    for (; (offset + 32) <= length; offset += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(input + offset));
+        __m256i special = _mm256_or_si256(CJSON_AVX2_AT_MOST(chunk, control), _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(special);
+        if (mask != 0)
+        {
+            return offset + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return offset + scan_unescaped_sse2(input + offset, length - offset);
+}
+
+/* __builtin_cpu_supports reads what libgcc detected at startup */
+#define CJSON_HAS_AVX2() __builtin_cpu_supports("avx2")
+#endif
+
+/* Tokens are mostly short: the first bytes are scanned one by one, and the vector code only
+ * takes over for the rest of a long run. */
+#define CJSON_SCAN_PREFIX 16
+
+#ifdef CJSON_SIMD_X86
+#define CJSON_SCAN_LONG(name, input, offset, length) \
+    (CJSON_HAS_AVX2() ? name##_avx2((input) + (offset), (length) - (offset)) : name##_sse2((input) + (offset), (length) - (offset)))
+#else
+#define CJSON_SCAN_LONG(name, input, offset, length) name##_scalar((input) + (offset), (length) - (offset))
+#endif
+
+/* length of the leading whitespace (bytes <= 32) */
+static size_t scan_whitespace(const unsigned char *input, size_t length)
+{
+    size_t prefix = (length < CJSON_SCAN_PREFIX) ? length : CJSON_SCAN_PREFIX;
+    size_t offset = 0;
+    while ((offset < prefix) && (input[offset] <= 32))
+    {
+        offset++;
+    }
+    if ((offset < prefix) || (offset == length))
+    {
+        return offset;
+    }
+    return offset + CJSON_SCAN_LONG(scan_whitespace, input, offset, length);
+}
+
+/* length of the prefix of a string literal before its closing quote or first escape sequence */
+static size_t scan_string(const unsigned char *input, size_t length)
+{
+    size_t prefix = (length < CJSON_SCAN_PREFIX) ? length : CJSON_SCAN_PREFIX;
+    size_t offset = 0;
+    while ((offset < prefix) && (input[offset] != '\"') && (input[offset] != '\\'))
+    {
+        offset++;
+    }
+    if ((offset < prefix) || (offset == length))
+    {
+        return offset;
+    }
+    return offset + CJSON_SCAN_LONG(scan_string, input, offset, length);
+}
+
+/* length of the prefix of a string that can be printed without escaping */
+static size_t scan_unescaped(const unsigned char *input, size_t length)
+{
+    size_t prefix = (length < CJSON_SCAN_PREFIX) ? length : CJSON_SCAN_PREFIX;
+    size_t offset = 0;
+    while ((offset < prefix) && (input[offset] > 31) && (input[offset] != '\"') && (input[offset] != '\\'))
+    {
+        offset++;
+    }
+    if ((offset < prefix) || (offset == length))
+    {
+        return offset;
+    }
+    return offset + CJSON_SCAN_LONG(scan_unescaped, input, offset, length);
+}
+
 /* Parse the input text into an unescaped cinput, and populate item. */
 static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -835,6 +1055,12 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         size_t skipped_bytes = 0;
         while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
         {
+            /* jump over the characters that are neither a quote nor a backslash */
+            input_end += scan_string(input_end, input_buffer->length - (size_t)(input_end - input_buffer->content));
+            if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end == '\"'))
+            {
+                break;
+            }
             /* is escape sequence */
             if (input_end[0] == '\\')
             {
@@ -868,7 +1094,12 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     {
         if (*input_pointer != '\\')
         {
-            *output_pointer++ = *input_pointer++;
+            /* copy the characters up to the next escape sequence at once */
+            const unsigned char *escape = (const unsigned char*)memchr(input_pointer, '\\', (size_t)(input_end - input_pointer));
+            size_t run = (escape != NULL) ? (size_t)(escape - input_pointer) : (size_t)(input_end - input_pointer);
+            memcpy(output_pointer, input_pointer, run);
+            output_pointer += run;
+            input_pointer += run;
         }
         /* escape sequence */
         else
@@ -954,6 +1185,8 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     size_t output_length = 0;
     /* numbers of additional characters needed for escaping */
     size_t escape_characters = 0;
+    size_t input_length = 0;
+    size_t plain_length = 0;
 
     if (output_buffer == NULL)
     {
@@ -973,8 +1206,12 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
         return true;
     }
 
+    /* most strings need no escaping: find the first character that does, if any */
+    input_length = strlen((const char*)input);
+    plain_length = scan_unescaped(input, input_length);
+
     /* set "flag" to 1 if something needs to be escaped */
-    for (input_pointer = input; *input_pointer; input_pointer++)
+    for (input_pointer = input + plain_length; *input_pointer; input_pointer++)
     {
         switch (*input_pointer)
         {
@@ -1017,9 +1254,10 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     }
 
     output[0] = '\"';
-    output_pointer = output + 1;
+    memcpy(output + 1, input, plain_length);
+    output_pointer = output + 1 + plain_length;
     /* copy the string */
-    for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++)
+    for (input_pointer = input + plain_length; *input_pointer != '\0'; (void)input_pointer++, output_pointer++)
     {
         if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\'))
         {
@@ -1094,10 +1332,7 @@ static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
         return buffer;
     }
 
-    while (can_access_at_index(buffer, 0) && (buffer_at_offset(buffer)[0] <= 32))
-    {
-       buffer->offset++;
-    }
+    buffer->offset += scan_whitespace(buffer_at_offset(buffer), buffer->length - buffer->offset);
 
     if (buffer->offset == buffer->length)
     {
@@ -1933,6 +2168,195 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
     return get_array_item(array, (size_t)index);
 }
 
+/* Open addressing table of the members of an object. Members are inserted in the order of the
+ * chain, so among the members sharing a hash the first one met while probing is the first one
+ * in the chain, which is the one the linear scan returns. Keys are hashed lowercased: the same
+ * index serves the case sensitive and the case insensitive lookups. */
+typedef struct cJSON_IndexSlot
+{
+    size_t hash;
+    cJSON *item;
+} cJSON_IndexSlot;
+
+struct cJSON_Index
+{
+    size_t mask;
+    size_t count;
+    cJSON_IndexSlot *slots;
+};
+
+static size_t hash_object_key(const unsigned char *key)
+{
+    size_t hash = 5381;
+    for (; *key != '\0'; key++)
+    {
+        hash = (hash * 33) ^ (size_t)tolower(*key);
+    }
+    return hash;
+}
+
+static void drop_object_index(cJSON * const object)
+{
+    if ((object != NULL) && (object->index != NULL))
+    {
+        global_hooks.deallocate(object->index);
+        object->index = NULL;
+    }
+}
+
+static void insert_in_object_index(struct cJSON_Index * const index, cJSON * const item)
+{
+    size_t hash = hash_object_key((const unsigned char*)item->string);
+    size_t slot = 0;
+
+    for (slot = hash & index->mask; index->slots[slot].item != NULL; slot = (slot + 1) & index->mask)
+    {
+    }
+    index->slots[slot].hash = hash;
+    index->slots[slot].item = item;
+    index->count++;
+}
+
+/* replaces the index of an object with a new one, sized for the members it has now;
+ * on failure the object simply stays without index */
+static cJSON_bool build_object_index(cJSON * const object)
+{
+    struct cJSON_Index *index = NULL;
+    cJSON *current_element = NULL;
+    size_t count = 0;
+    size_t capacity = 1;
+
+    drop_object_index(object);
+
+    /* references share the chain of another item, which could change behind their back */
+    if (object->type & cJSON_IsReference)
+    {
+        return false;
+    }
+
+    for (current_element = object->child; current_element != NULL; current_element = current_element->next)
+    {
+        /* the case sensitive scan stops at a member without name: leave such objects to it */
+        if (current_element->string == NULL)
+        {
+            return false;
+        }
+        count++;
+    }
+    /* leave room for the members added afterwards */
+    while (capacity < (count * 4))
+    {
+        capacity *= 2;
+    }
+
+    index = (struct cJSON_Index*)global_hooks.allocate(sizeof(struct cJSON_Index) + (capacity * sizeof(cJSON_IndexSlot)));
+    if (index == NULL)
+    {
+        return false;
+    }
+    index->mask = capacity - 1;
+    index->count = 0;
+    index->slots = (cJSON_IndexSlot*)(index + 1);
+    memset(index->slots, '\0', capacity * sizeof(cJSON_IndexSlot));
+
+    for (current_element = object->child; current_element != NULL; current_element = current_element->next)
+    {
+        insert_in_object_index(index, current_element);
+    }
+
+    object->index = index;
+    return true;
+}
+
+/* an item appended to the chain comes after all the others: it joins the index, which grows when full */
+static void append_to_object_index(cJSON * const object, cJSON * const item)
+{
+    if (object->index == NULL)
+    {
+        return;
+    }
+    if ((item->string == NULL) || (((object->index->count + 1) * 2) > (object->index->mask + 1)))
+    {
+        build_object_index(object);
+        return;
+    }
+    insert_in_object_index(object->index, item);
+}
+
+/* the slots following a freed one move back, so that no probe stops early; they keep their
+ * order, so members sharing a key are still met in the order of the chain */
+static void remove_from_object_index(cJSON * const object, const cJSON * const item)
+{
+    struct cJSON_Index *index = object->index;
+    size_t slot = 0;
+    size_t next = 0;
+
+    if ((index == NULL) || (item->string == NULL))
+    {
+        return;
+    }
+
+    for (slot = hash_object_key((const unsigned char*)item->string) & index->mask; index->slots[slot].item != item; slot = (slot + 1) & index->mask)
+    {
+        if (index->slots[slot].item == NULL)
+        {
+            return;
+        }
+    }
+
+    for (next = (slot + 1) & index->mask; index->slots[next].item != NULL; next = (next + 1) & index->mask)
+    {
+        size_t home = index->slots[next].hash & index->mask;
+
+        /* a slot whose probe starts between the hole and itself must stay where it is */
+        if (((next - home) & index->mask) >= ((next - slot) & index->mask))
+        {
+            index->slots[slot] = index->slots[next];
+            slot = next;
+        }
+    }
+    index->slots[slot].item = NULL;
+    index->count--;
+}
+
+static cJSON *find_in_object_index(const struct cJSON_Index * const index, const char * const name, const cJSON_bool case_sensitive)
+{
+    size_t hash = hash_object_key((const unsigned char*)name);
+    size_t slot = 0;
+
+    for (slot = hash & index->mask; index->slots[slot].item != NULL; slot = (slot + 1) & index->mask)
+    {
+        cJSON *item = index->slots[slot].item;
+        if (index->slots[slot].hash != hash)
+        {
+            continue;
+        }
+        if (case_sensitive ? (strcmp(name, item->string) == 0) : (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)item->string) == 0))
+        {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+/* an item placed in the middle of the chain may only go to the end of its probe when no other
+ * member has its key; otherwise the index is built again, in the order of the chain */
+static void place_in_object_index(cJSON * const object, cJSON * const item)
+{
+    if (object->index == NULL)
+    {
+        return;
+    }
+    if ((item->string == NULL) || (((object->index->count + 1) * 2) > (object->index->mask + 1)) ||
+        (find_in_object_index(object->index, item->string, false) != NULL))
+    {
+        build_object_index(object);
+        return;
+    }
+    insert_in_object_index(object->index, item);
+}
+
 static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = NULL;
@@ -1942,6 +2366,11 @@ static cJSON *get_object_item(const cJSON * const object, const char * const nam
         return NULL;
     }
 
+    if (object->index != NULL)
+    {
+        return find_in_object_index(object->index, name, case_sensitive);
+    }
+
     current_element = object->child;
     if (case_sensitive)
     {
@@ -1980,6 +2409,33 @@ CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *st
     return cJSON_GetObjectItem(object, string) ? 1 : 0;
 }
 
+CJSON_PUBLIC(cJSON_bool) cJSON_IndexObject(cJSON *object)
+{
+    const cJSON *current_element = NULL;
+    size_t count = 0;
+
+    if ((object == NULL) || ((object->type & 0xFF) != cJSON_Object))
+    {
+        return false;
+    }
+    if (object->index != NULL)
+    {
+        return true;
+    }
+
+    /* a short chain is scanned faster than it is hashed */
+    for (current_element = object->child; (current_element != NULL) && (count <= CJSON_INDEX_THRESHOLD); current_element = current_element->next)
+    {
+        count++;
+    }
+    if (count <= CJSON_INDEX_THRESHOLD)
+    {
+        return false;
+    }
+
+    return build_object_index(object);
+}
+
 /* Utility for array list handling. */
 static void suffix_object(cJSON *prev, cJSON *item)
 {
@@ -2004,6 +2460,7 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->index = NULL;
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -2028,6 +2485,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         array->child = item;
         item->prev = item;
         item->next = NULL;
+        append_to_object_index(array, item);
     }
     else
     {
@@ -2036,6 +2494,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         {
             suffix_object(child->prev, item);
             array->child->prev = item;
+            append_to_object_index(array, item);
         }
     }
 
@@ -2272,6 +2731,7 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
     /* make sure the detached item doesn't point anywhere anymore */
     item->prev = NULL;
     item->next = NULL;
+    remove_from_object_index(parent, item);
 
     return item;
 }
@@ -2347,6 +2807,7 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
     {
         newitem->prev->next = newitem;
     }
+    place_in_object_index(array, newitem);
     return true;
 }
 
@@ -2394,6 +2855,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
 
     item->next = NULL;
     item->prev = NULL;
+    remove_from_object_index(parent, item);
+    place_in_object_index(parent, replacement);
     cJSON_Delete(item);
 
     return true;
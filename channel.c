@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "channel.h"
+#include "reactor.h"
+#include "session.h"
+#include "config.h"
+#include "msglog.h"
+
+// Table des salons à sondage linéaire, jamais plus d'à moitié pleine
+#define CHANNEL_SLOTS (CHANNEL_MAX * 2)
+
+static pthread_mutex_t channels_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Channel **channel_slots = NULL;
+static size_t channel_count = 0;
+
+// Salon courant de chaque socket. Une entrée n'est lue et modifiée que par le thread du reactor
+// qui sert le socket.
+static Channel **memberships = NULL;
+static int memberships_capacity = 0;
+
+// Audience de la diffusion en cours sur ce thread
+static __thread Bitset audience;
+
+/**
+ ** Hashes a channel name with 32-bit FNV-1a.
+ * @param name (const char*) - The name.
+ * @returns uint32_t - Its hash.
+ */
+static uint32_t channelHash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0')
+    {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ ** Finds the slot of a channel name: the slot holding it, or the free slot where it would go.
+ * @param name (const char*) - The name.
+ * @returns size_t - The slot. The caller must hold channels_mutex.
+ */
+static size_t channelSlot(const char *name)
+{
+    size_t slot = channelHash(name) % CHANNEL_SLOTS;
+
+    while (channel_slots[slot] != NULL && strcmp(channel_slots[slot]->name, name) != 0)
+        slot = (slot + 1) % CHANNEL_SLOTS;
+    return slot;
+}
+
+/**
+ ** Allocates the channel table and the membership table, then creates the general channel.
+ * @param capacity (int) - The number of file descriptors the process may open.
+ * @returns int - 0 on success, -1 on error.
+ */
+int channelInit(int capacity)
+{
+    channel_slots = calloc(CHANNEL_SLOTS, sizeof(Channel *));
+    memberships = calloc(capacity, sizeof(Channel *));
+
+    if (channel_slots == NULL || memberships == NULL)
+    {
+        perror("calloc channels");
+        return -1;
+    }
+    memberships_capacity = capacity;
+
+    if (channelCreate(CHANNEL_GENERAL, NULL) != 0)
+    {
+        fprintf(stderr, "Impossible de créer le salon %s\n", CHANNEL_GENERAL);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ ** Tells whether a string can name a channel: 1 to 31 letters, digits, '-' or '_'.
+ * @param name (const char*) - The name.
+ * @returns int - 1 if it is valid, 0 otherwise.
+ */
+int channelNameIsValid(const char *name)
+{
+    size_t length = 0;
+
+    for (; name[length] != '\0'; length++)
+    {
+        unsigned char c = (unsigned char)name[length];
+
+        if (length >= CHANNEL_NAME_SIZE - 1 || !(isalnum(c) || c == '-' || c == '_'))
+            return 0;
+    }
+    return length > 0;
+}
+
+/**
+ ** Creates a channel.
+ * @param name (const char*) - Its name, valid according to channelNameIsValid.
+ * @param created (Channel**) - Receives the channel; may be NULL.
+ * @returns int - 0 on success, 1 if the channel exists, -1 if there are too many channels or memory is exhausted.
+ */
+int channelCreate(const char *name, Channel **created)
+{
+    pthread_mutex_lock(&channels_mutex);
+
+    size_t slot = channelSlot(name);
+
+    if (channel_slots[slot] != NULL)
+    {
+        pthread_mutex_unlock(&channels_mutex);
+        return 1;
+    }
+
+    Channel *channel = channel_count < CHANNEL_MAX ? calloc(1, sizeof(Channel)) : NULL;
+
+    if (channel == NULL || bitsetInit(&channel->members, (size_t)memberships_capacity) == -1)
+    {
+        pthread_mutex_unlock(&channels_mutex);
+        free(channel);
+        return -1;
+    }
+    if (historyInit(&channel->history, (size_t)server_config.history_size, server_config.history_bytes) == -1)
+    {
+        pthread_mutex_unlock(&channels_mutex);
+        bitsetFree(&channel->members);
+        free(channel);
+        return -1;
+    }
+
+    strcpy(channel->name, name);
+    pthread_mutex_init(&channel->lock, NULL);
+
+    channel_slots[slot] = channel;
+    channel_count++;
+    pthread_mutex_unlock(&channels_mutex);
+
+    if (created != NULL)
+        *created = channel;
+    return 0;
+}
+
+/**
+ ** Finds a channel by name.
+ * @param name (const char*) - The name.
+ * @returns Channel* - The channel, or NULL if there is none.
+ */
+Channel *channelFind(const char *name)
+{
+    pthread_mutex_lock(&channels_mutex);
+    Channel *channel = channel_slots[channelSlot(name)];
+    pthread_mutex_unlock(&channels_mutex);
+    return channel;
+}
+
+/**
+ ** Queues the last messages of a channel for a socket that just joined it. The reactor runs commands
+ * with the output of the connection held back, so the backlog leaves in a single write.
+ * The caller holds the channel lock: no broadcast gets between the backlog and the live messages.
+ * @param channel (Channel*) - The channel.
+ * @param fd (int) - The client socket, served by the calling reactor thread.
+ * @returns void
+ */
+static void replayHistory(Channel *channel, int fd)
+{
+    size_t count = (size_t)server_config.history_replay;
+    Connection *conn = reactorGetConnection(fd);
+
+    if (count > channel->history.capacity)
+        count = channel->history.capacity;
+    if (count == 0 || conn == NULL || sessionGet(fd) == NULL)
+        return;
+
+    HistoryMessage *messages = malloc(count * sizeof(HistoryMessage));
+
+    if (messages == NULL)
+        return;
+
+    size_t copied = historyLast(&channel->history, count, messages);
+
+    for (size_t i = 0; i < copied; i++)
+    {
+        connectionSend(conn, messages[i].parts, messages[i].part_count, SEND_BROADCAST);
+        historyMessageRelease(&messages[i]);
+    }
+    free(messages);
+}
+
+/**
+ ** Moves a socket into a channel, out of the one it was in, and sends it the channel's backlog
+ * if a user is logged in on it.
+ * @param channel (Channel*) - The channel.
+ * @param fd (int) - The client socket, served by the calling reactor thread.
+ * @returns int - 0 on success, -1 if the socket is out of range.
+ */
+int channelJoin(Channel *channel, int fd)
+{
+    if (fd < 0 || fd >= memberships_capacity)
+        return -1;
+
+    if (memberships[fd] == channel)
+        return 0;
+    channelLeave(fd);
+
+    // The lock orders the change with the broadcasts: none of them sees a half-moved socket
+    pthread_mutex_lock(&channel->lock);
+    bitsetSet(&channel->members, (size_t)fd);
+    replayHistory(channel, fd);
+    pthread_mutex_unlock(&channel->lock);
+
+    memberships[fd] = channel;
+    return 0;
+}
+
+/**
+ ** Takes a socket out of its channel, if it is in one. Called before the socket is closed,
+ * so that a channel never holds a descriptor that could be reused by another client.
+ * @param fd (int) - The client socket, served by the calling reactor thread.
+ * @returns void
+ */
+void channelLeave(int fd)
+{
+    if (fd < 0 || fd >= memberships_capacity || memberships[fd] == NULL)
+        return;
+
+    Channel *channel = memberships[fd];
+
+    pthread_mutex_lock(&channel->lock);
+    bitsetClear(&channel->members, (size_t)fd);
+    pthread_mutex_unlock(&channel->lock);
+
+    memberships[fd] = NULL;
+}
+
+/**
+ ** Returns the channel a socket is in.
+ * @param fd (int) - The client socket, served by the calling reactor thread.
+ * @returns Channel* - The channel, or NULL if it is in none.
+ */
+Channel *channelOf(int fd)
+{
+    if (fd < 0 || fd >= memberships_capacity)
+        return NULL;
+    return memberships[fd];
+}
+
+/**
+ ** Sends a message to every logged-in member of a channel, and to nobody else, and keeps it in
+ * the channel's history and in the message log. The audience is the intersection of the members
+ * with the open sessions, up to the highest socket in use; each shard then only visits the bits it
+ * shares with it. Lock order: the channel, then each shard in turn; no shard lock is held when a
+ * channel is locked.
+ * @param channel (Channel*) - The channel.
+ * @param parts (MessageBuffer**) - The shared buffers making up the message; each member only takes references.
+ * @param part_count (int) - The number of buffers.
+ * @returns void
+ */
+void channelBroadcast(Channel *channel, MessageBuffer **parts, int part_count)
+{
+    if (audience.words == NULL && bitsetInit(&audience, (size_t)memberships_capacity) == -1)
+        return;
+
+    pthread_mutex_lock(&channel->lock);
+    historyAppend(&channel->history, parts, part_count);
+    // Appended under the channel lock: the log keeps the order in which the members got the messages
+    if (msglogEnabled())
+        msglogAppend(channel->name, parts, part_count);
+
+    // Sized for every possible descriptor: only the words up to the highest session are combined and scanned
+    size_t high_water = sessionHighWater();
+    Bitset scope = bitsetPrefix(&audience, high_water);
+    Bitset members = bitsetPrefix(&channel->members, high_water);
+    Bitset online = bitsetPrefix(sessionOnline(), high_water);
+
+    bitsetAnd(&scope, &members, &online);
+    for (int i = 0; i < reactorCount(); i++)
+    {
+        Reactor *reactor = reactorGet(i);
+
+        pthread_mutex_lock(&reactor->clients_mutex);
+        for (long fd = bitsetNextCommon(&scope, &reactor->sockets, 0); fd != -1;
+             fd = bitsetNextCommon(&scope, &reactor->sockets, (size_t)fd + 1))
+        {
+            Connection *conn = reactorShardConnection(reactor, (int)fd);
+
+            if (conn != NULL)
+                connectionSend(conn, parts, part_count, SEND_BROADCAST);
+        }
+        pthread_mutex_unlock(&reactor->clients_mutex);
+    }
+    pthread_mutex_unlock(&channel->lock);
+}
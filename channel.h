@@ -0,0 +1,36 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <pthread.h>
+#include "bitset.h"
+#include "buffer.h"
+#include "history.h"
+
+#define CHANNEL_NAME_SIZE 32
+#define CHANNEL_MAX 1024
+#define CHANNEL_GENERAL "general"
+
+/*
+ * Salon de discussion. Ses membres forment un ensemble de sockets de la taille de celui des
+ * sessions: l'audience d'une diffusion est leur intersection, calculée mot à mot.
+ * Son historique garde les derniers messages diffusés, renvoyés à qui entre dans le salon.
+ * Les salons ne sont jamais libérés tant que le serveur tourne.
+ */
+typedef struct channel
+{
+    char name[CHANNEL_NAME_SIZE];
+    pthread_mutex_t lock;
+    Bitset members;
+    History history;
+} Channel;
+
+int channelInit(int capacity);
+int channelCreate(const char *name, Channel **created);
+Channel *channelFind(const char *name);
+int channelJoin(Channel *channel, int fd);
+void channelLeave(int fd);
+Channel *channelOf(int fd);
+void channelBroadcast(Channel *channel, MessageBuffer **parts, int part_count);
+int channelNameIsValid(const char *name);
+
+#endif
@@ -8,10 +8,72 @@
 #include <sys/time.h>
 #include <pthread.h>
 #include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "protocol.h"
 
 #define MAX_MESSAGE_SIZE 2000
 
-int inDownload = 0;
+// Transfert de fichier annoncé par le serveur, exécuté sur une connexion de données
+typedef struct transfer
+{
+    char token[65];
+    int isUpload;
+    char filename[256];
+    long size;
+} Transfer;
+
+FrameDecoder decoder;
+int negotiated = 0;
+struct sockaddr_in serverAddress;
+
+void startTransfer(const char *message);
+
+/**
+ ** Sends a text message to the server in a v2 frame.
+ * @param socketFd (int) - The server socket file descriptor.
+ * @param message (const char*) - The message to send.
+ * @returns int - 0 on success, -1 on error.
+ */
+int sendText(int socketFd, const char *message)
+{
+    return frameSend(socketFd, FRAME_TEXT, message, strlen(message));
+}
+
+/**
+ ** Reads the next frame sent by the server. Until the server has answered HELLO,
+ * the text prompt it sent before knowing our protocol is skipped.
+ * @param socketFd (int) - The server socket file descriptor.
+ * @param frame (Frame*) - Receives the frame.
+ * @returns int - 1 if a frame was read, 0 if the connection was closed, -1 on error.
+ */
+int readFrame(int socketFd, Frame *frame)
+{
+    while (!negotiated)
+    {
+        frameDecoderResync(&decoder);
+
+        if (frameDecoderHasFrame(&decoder))
+        {
+            int result = frameDecoderNext(&decoder, frame);
+            if (result != 1)
+                return result;
+            if (frame->type == FRAME_HELLO)
+                negotiated = 1;
+            continue;
+        }
+
+        size_t available;
+        char *space = frameDecoderSpace(&decoder, 1024, &available);
+        if (space == NULL)
+            return -1;
+
+        int bytesRead = recv(socketFd, space, available, 0);
+        if (bytesRead <= 0)
+            return bytesRead == 0 ? 0 : -1;
+        frameDecoderCommit(&decoder, bytesRead);
+    }
+    return frameRead(socketFd, &decoder, frame);
+}
 
 /**
  ** Thread function to receive and print messages from the server.
@@ -21,26 +83,26 @@ int inDownload = 0;
 void *receiveMessages(void *socketPtr)
 {
     int socketFd = *((int *)socketPtr);
-    char buffer[1024];
+    Frame frame;
 
     while (1)
     {
-        int bytesRead = recv(socketFd, buffer, sizeof(buffer) - 1, 0);
-        if (bytesRead > 0)
+        int result = readFrame(socketFd, &frame);
+        if (result > 0)
         {
-            buffer[bytesRead] = '\0';
-            if (strcmp(buffer, "__END__") == 0)
+            if (frame.type != FRAME_TEXT)
             {
                 continue;
             }
-            if (strcmp(buffer, "Fichier reçu avec succès\n") == 0 || strcmp(buffer, "Fichier reçu avec succès") == 0)
+            if (strncmp(frame.payload, "TRANSFER:", 9) == 0)
             {
+                startTransfer(frame.payload);
                 continue;
             }
-            printf("%s\n", buffer);
+            printf("%s\n", frame.payload);
             fflush(stdout);
         }
-        else if (bytesRead == 0)
+        else if (result == 0)
         {
             printf("\nConnexion fermée par le serveur\n");
             exit(0);
@@ -58,7 +120,26 @@ void *receiveMessages(void *socketPtr)
 }
 
 /**
- ** Send a local file in binary mode to the server.
+ ** Create a directory if it does not exist.
+ * @param dir (const char*) - The name of the directory to create.
+ * @returns void
+ */
+void createDirectory(const char *dir)
+{
+    struct stat st = {0};
+    if (stat(dir, &st) == -1)
+    {
+        if (mkdir(dir, 0700) != 0)
+        {
+            perror("Erreur lors de la création du répertoire");
+            return;
+        }
+    }
+}
+
+/**
+ ** Ask the server to receive a local file. The data itself is sent by a transfer thread
+ * once the server has answered with a transfer token.
  * @param socketFd (int) - The server socket file descriptor.
  * @param filename (const char*) - The name of the file to upload.
  * @returns void
@@ -70,178 +151,224 @@ void uploadFile(int socketFd, const char *filename)
         printf("Nom de fichier invalide.\n");
         return;
     }
-    FILE *file = fopen(filename, "rb");
-    if (file == NULL)
+
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
     {
         printf("Erreur: Impossible d'ouvrir le fichier %s\n", filename);
         return;
     }
 
     char command[256];
+    snprintf(command, sizeof(command), "@upload %s %ld", filename, (long)st.st_size);
+    sendText(socketFd, command);
+}
 
-    snprintf(command, sizeof(command), "@upload %s", filename);
-    send(socketFd, command, strlen(command), 0);
-    usleep(100000);
-
-    char buffer[1024];
-    size_t bytes;
-    size_t total = 0;
-
-    printf("Envoi du fichier %s...\n", filename);
-
-    while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+/**
+ ** Ask the server to send a remote file. It is received by a transfer thread
+ * once the server has answered with a transfer token.
+ * @param socketFd (int) - The server socket file descriptor.
+ * @param filename (const char*) - The name of the file to download.
+ * @returns void
+ */
+void downloadFile(int socketFd, const char *filename)
+{
+    if (strstr(filename, "..") != NULL)
     {
-        send(socketFd, buffer, bytes, 0);
-        total += bytes;
-        printf("\rProgression: %zu octets envoyés", total);
-        fflush(stdout);
-        usleep(10000);
+        printf("Nom de fichier invalide.\n");
+        return;
     }
-    printf("\n");
-    usleep(100000);
-    send(socketFd, "__END__", 7, 0);
-    printf("Fichier envoyé avec succès!\n");
-    fclose(file);
+
+    char command[300];
+    snprintf(command, sizeof(command), "@download %s", filename);
+    sendText(socketFd, command);
 }
 
 /**
- ** Create a directory if it does not exist.
- * @param dir (const char*) - The name of the directory to create.
+ ** Send a local file on a data connection.
+ * @param dataFd (int) - The data connection.
+ * @param transfer (Transfer*) - The transfer announced by the server.
  * @returns void
  */
-void createDirectory(const char *dir)
+void sendFileData(int dataFd, Transfer *transfer)
 {
-    struct stat st = {0};
-    if (stat(dir, &st) == -1)
+    int file = open(transfer->filename, O_RDONLY);
+    if (file < 0)
     {
-        if (mkdir(dir, 0700) != 0)
+        printf("Erreur: Impossible d'ouvrir le fichier %s\n", transfer->filename);
+        return;
+    }
+
+    // Exactly the announced size is sent, straight from the page cache
+    off_t offset = 0;
+    while (offset < transfer->size)
+    {
+        ssize_t sent = sendfile(dataFd, file, &offset, transfer->size - offset);
+        if (sent <= 0)
         {
-            perror("Erreur lors de la création du répertoire");
-            return;
+            if (sent < 0 && errno == EINTR)
+                continue;
+            break;
         }
     }
+    close(file);
+
+    if (offset == transfer->size)
+        printf("Fichier '%s' envoyé (%ld octets).\n", transfer->filename, transfer->size);
+    else
+        printf("Erreur lors de l'envoi de '%s': %ld/%ld octets.\n", transfer->filename, (long)offset, transfer->size);
 }
 
 /**
- ** Download a remote file from the server and save it locally.
- * @param socketFd (int) - The server socket file descriptor.
- * @param filename (const char*) - The name of the file to download.
+ ** Receive a remote file on a data connection and save it in 'downloads/'.
+ * @param dataFd (int) - The data connection.
+ * @param transfer (Transfer*) - The transfer announced by the server.
  * @returns void
  */
-void downloadFile(int socketFd, const char *filename)
+void receiveFileData(int dataFd, Transfer *transfer)
 {
-    extern int inDownload;
-    inDownload = 1;
+    FrameDecoder input;
+    Frame frame;
+    long filesize = -1;
 
-    if (strstr(filename, "..") != NULL)
+    frameDecoderInit(&input);
+
+    // The server writes its text prompt before it knows the protocol: it is skipped,
+    // then a FRAME_TRANSFER gives the size and the raw bytes follow
+    while (filesize < 0)
     {
-        printf("Nom de fichier invalide.\n");
-        inDownload = 0;
-        return;
-    }
+        frameDecoderResync(&input);
 
-    char command[300];
-    snprintf(command, sizeof(command), "@download %s", filename);
-    send(socketFd, command, strlen(command), 0);
+        if (frameDecoderHasFrame(&input))
+        {
+            if (frameDecoderNext(&input, &frame) != 1)
+                break;
+            if (frame.type == FRAME_TRANSFER)
+                filesize = atol(frame.payload);
+            continue;
+        }
 
-    char response[1024] = {0};
-    int len = recv(socketFd, response, sizeof(response) - 1, 0);
+        size_t available;
+        char *space = frameDecoderSpace(&input, 1024, &available);
+        int bytesRead = space != NULL ? recv(dataFd, space, available, 0) : -1;
 
-    if (len <= 0)
-    {
-        perror("Erreur de réception initiale");
-        inDownload = 0;
-        return;
+        if (bytesRead <= 0)
+            break;
+        frameDecoderCommit(&input, bytesRead);
     }
-    response[len] = '\0';
-    char serverFilename[256];
-    long filesize;
 
-    if (sscanf(response, "READY_TO_SEND:%255[^:]:%ld", serverFilename, &filesize) != 2)
+    if (filesize < 0)
     {
-        printf("Erreur: Réponse inattendue du serveur: %s\n", response);
-        inDownload = 0;
+        printf("Erreur: le serveur n'a pas envoyé '%s'.\n", transfer->filename);
+        frameDecoderFree(&input);
         return;
     }
-    printf("Téléchargement de '%s' (%ld octets) depuis le serveur...\n", serverFilename, filesize);
-    send(socketFd, "READY", 5, 0);
 
     char localPath[300];
-    snprintf(localPath, sizeof(localPath), "downloads/%s", serverFilename);
+    snprintf(localPath, sizeof(localPath), "downloads/%s", transfer->filename);
     createDirectory("downloads");
     FILE *file = fopen(localPath, "wb");
 
     if (!file)
     {
         perror("Erreur lors de la création du fichier local");
-        inDownload = 0;
+        frameDecoderFree(&input);
         return;
     }
 
-    char buffer[1024];
+    char buffer[65536];
     long received = 0;
 
     while (received < filesize)
     {
-        int n = recv(socketFd, buffer, sizeof(buffer), 0);
-        if (n <= 0)
-        {
-            printf("Erreur lors du transfert. Reçu %ld/%ld octets.\n", received, filesize);
-            break;
-        }
-        long toWrite = n;
-        if (received + n > filesize)
+        size_t wanted = filesize - received < (long)sizeof(buffer) ? (size_t)(filesize - received) : sizeof(buffer);
+        int n;
+
+        if (frameDecoderPending(&input) > 0)
         {
-            toWrite = filesize - received;
+            n = (int)frameDecoderTake(&input, buffer, wanted);
         }
-        if (received + toWrite == filesize)
+        else
         {
-            int extra = n - toWrite;
-            if (extra > 0)
-            {
-                if (memcmp(buffer + toWrite, "__END__", 7) == 0)
-                {
-                    n = toWrite;
-                }
-            }
+            n = recv(dataFd, buffer, wanted, 0);
         }
-        fwrite(buffer, 1, toWrite, file);
-        received += toWrite;
-        printf("\rRéception: %ld/%ld octets (%.1f%%)", received, filesize, (float)received / filesize * 100);
-        fflush(stdout);
-        if (received >= filesize)
+        if (n <= 0)
         {
             break;
         }
+        fwrite(buffer, 1, n, file);
+        received += n;
     }
 
     fclose(file);
-    inDownload = 0;
+    frameDecoderFree(&input);
 
-    int confirmationShown = 0;
-    char endMarker[16] = {0};
-    int endLen = recv(socketFd, endMarker, sizeof(endMarker) - 1, 0);
+    if (received == filesize)
+    {
+        printf("Fichier '%s' téléchargé avec succès dans 'downloads/'.\n", transfer->filename);
+    }
+    else
+    {
+        printf("Téléchargement incomplet : %ld/%ld octets.\n", received, filesize);
+    }
+}
 
-    if (endLen > 0 && strstr(endMarker, "__END__") != NULL)
+/**
+ ** Run one file transfer on its own connection, so that the chat keeps working meanwhile.
+ * @param transferPtr (void*) - The transfer announced by the server, freed at the end.
+ * @returns void*
+ */
+void *runTransfer(void *transferPtr)
+{
+    Transfer *transfer = (Transfer *)transferPtr;
+    int dataFd = socket(PF_INET, SOCK_STREAM, 0);
+
+    if (dataFd == -1 || connect(dataFd, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) == -1)
     {
-        char confirmMsg[256] = {0};
-        int confirmLen = recv(socketFd, confirmMsg, sizeof(confirmMsg) - 1, 0);
-        if (confirmLen > 0)
-        {
-            confirmMsg[confirmLen] = '\0';
-            printf("\n Fichier '%s' téléchargé avec succès dans 'downloads/'.\n", serverFilename);
-            confirmationShown = 1;
-        }
+        perror("connexion de transfert");
     }
-    else if (endLen > 0)
+    else if (frameSend(dataFd, FRAME_TRANSFER, transfer->token, strlen(transfer->token)) == 0)
+    {
+        if (transfer->isUpload)
+            sendFileData(dataFd, transfer);
+        else
+            receiveFileData(dataFd, transfer);
+    }
+
+    if (dataFd != -1)
+        close(dataFd);
+    free(transfer);
+    return NULL;
+}
+
+/**
+ ** Start the transfer announced by a "TRANSFER:token:direction:name:size" message.
+ * @param message (const char*) - The message received from the server.
+ * @returns void
+ */
+void startTransfer(const char *message)
+{
+    Transfer *transfer = malloc(sizeof(Transfer));
+    char direction[16];
+
+    if (transfer == NULL)
+        return;
+
+    if (sscanf(message, "TRANSFER:%64[^:]:%15[^:]:%255[^:]:%ld", transfer->token, direction, transfer->filename, &transfer->size) != 4)
     {
-        endMarker[endLen] = '\0';
-        printf("%s", endMarker);
+        free(transfer);
+        return;
     }
-    if (received != filesize)
+    transfer->isUpload = strcmp(direction, "upload") == 0;
+
+    pthread_t threadId;
+    if (pthread_create(&threadId, NULL, runTransfer, transfer) != 0)
     {
-        printf("\nTéléchargement incomplet : %ld/%ld octets.\n", received, filesize);
+        perror("pthread_create");
+        free(transfer);
+        return;
     }
+    pthread_detach(threadId);
 }
 
 /**
@@ -257,18 +384,25 @@ int main()
         exit(1);
     }
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons((short)31473);
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_addr.s_addr = INADDR_ANY;
+    serverAddress.sin_port = htons((short)31473);
 
-    int res = connect(socketFd, (struct sockaddr *)&addr, sizeof(addr));
+    int res = connect(socketFd, (struct sockaddr *)&serverAddress, sizeof(serverAddress));
 
     if (res == -1)
     {
         perror("connect");
         exit(1);
     }
+    // Announce the v2 protocol: every message is then framed in both directions
+    frameDecoderInit(&decoder);
+    if (frameSend(socketFd, FRAME_HELLO, PROTOCOL_VERSION, strlen(PROTOCOL_VERSION)) != 0)
+    {
+        perror("send");
+        exit(1);
+    }
+
     pthread_t threadId;
     if (pthread_create(&threadId, NULL, receiveMessages, &socketFd) != 0)
     {
@@ -282,18 +416,12 @@ int main()
     fgets(buffer, sizeof(buffer), stdin);
     buffer[strcspn(buffer, "\n")] = 0;
 
-    send(socketFd, buffer, strlen(buffer), 0);
+    sendText(socketFd, buffer);
     fgets(buffer, sizeof(buffer), stdin);
     buffer[strcspn(buffer, "\n")] = 0;
 
-    send(socketFd, buffer, strlen(buffer), 0);
-    int len = recv(socketFd, buffer, sizeof(buffer) - 1, 0);
+    sendText(socketFd, buffer);
 
-    if (len > 0)
-    {
-        buffer[len] = '\0';
-        printf("%s\n", buffer);
-    }
     while (1)
     {
         if (fgets(message, MAX_MESSAGE_SIZE + 1, stdin) == NULL)
@@ -304,7 +432,7 @@ int main()
         message[strcspn(message, "\n")] = 0;
         if (strcmp(message, "@help") == 0 || strcmp(message, "@credits") == 0)
         {
-            send(socketFd, message, strlen(message), 0);
+            sendText(socketFd, message);
             continue;
         }
         if (strncmp(message, "@upload", 7) == 0)
@@ -316,7 +444,7 @@ int main()
             }
             else
             {
-                send(socketFd, "Nom de fichier manquant.\n", 26, 0);
+                printf("Nom de fichier manquant.\n");
             }
             continue;
         }
@@ -325,15 +453,7 @@ int main()
             char filename[100];
             if (sscanf(message + 10, "%s", filename) == 1)
             {
-                pthread_cancel(threadId);
-                pthread_join(threadId, NULL);
                 downloadFile(socketFd, filename);
-                if (pthread_create(&threadId, NULL, receiveMessages, &socketFd) != 0)
-                {
-                    perror("pthread_create");
-                    close(socketFd);
-                    exit(1);
-                }
             }
             else
             {
@@ -343,8 +463,7 @@ int main()
         }
         else
         {
-            int bytesSent = send(socketFd, message, strlen(message) + 1, 0);
-            if (bytesSent == -1)
+            if (sendText(socketFd, message) == -1)
             {
                 perror("send");
                 continue;
@@ -1,48 +1,21 @@
+#define _GNU_SOURCE
 #include "command.h"
 #include "ChainedList.h"
 #include <string.h>
 #include <stdlib.h>
 #include "user.h"
+#include "stats.h"
+#include "buffer.h"
+#include "session.h"
+#include "channel.h"
+#include "msglog.h"
 #include <stdio.h>
 
 void sendFileContent(int client, const char *filename);
-void upload(int socketFd, const char *filename);
+void upload(int socketFd, const char *argument);
 void download(int socketFd, const char *input);
 void sendAllClients(const char *message);
-
-/**
- ** Parses a command string and returns the corresponding Command enum.
- * @param msg (const char*) - The command string to parse.
- * @returns Command - The parsed command type.
- */
-Command parseCommand(const char *msg)
-{
-    if (strncasecmp(msg, "@command", 8) == 0)
-        return COMMAND;
-    if (strncasecmp(msg, "@help", 5) == 0)
-        return HELP;
-    if (strncasecmp(msg, "@ping", 5) == 0)
-        return PING;
-    if (strncasecmp(msg, "@msg", 4) == 0)
-        return MSG;
-    if (strncasecmp(msg, "@connect", 8) == 0)
-        return CONNECT;
-    if (strncasecmp(msg, "@credits", 8) == 0)
-        return CREDITS;
-    if (strncasecmp(msg, "@shutdown", 9) == 0)
-        return SHUTDOWN;
-    if (strncasecmp(msg, "@create", 7) == 0)
-        return CREATE;
-    if (strncasecmp(msg, "@join", 5) == 0)
-        return JOIN;
-    if (strncasecmp(msg, "@leave", 6) == 0)
-        return LEAVE;
-    if (strncasecmp(msg, "@upload", 7) == 0)
-        return UPLOAD;
-    if (strncasecmp(msg, "@download", 9) == 0)
-        return DOWNLOAD;
-    return UNKNOWN;
-}
+void send_client_data(int socket_fd, const void *data, size_t length);
 
 /**
  ** Sends a private message to a user if authenticated.
@@ -53,21 +26,57 @@ Command parseCommand(const char *msg)
  */
 void privateMessage(int senderSock, const char *username, const char *msg)
 {
-    User *user = findUserByName(username);
-    if (user != NULL && user->authenticated)
+    int recipient = findUserSocket(username);
+    if (recipient >= 0)
     {
         char fullMsg[1024];
         snprintf(fullMsg, sizeof(fullMsg), "[privé] %s", msg);
-        send(user->socket_fd, fullMsg, strlen(fullMsg), 0);
+        send_client_data(recipient, fullMsg, strlen(fullMsg));
     }
     else
     {
         char fullMsg[1024];
         snprintf(fullMsg, sizeof(fullMsg), "Utilisateur '%s' introuvable ou non connecté.", username);
-        send(senderSock, fullMsg, strlen(fullMsg), 0);
+        send_client_data(senderSock, fullMsg, strlen(fullMsg));
     }
 }
 
+// Messages renvoyés au plus par @history; la réponse indique où reprendre
+#define HISTORY_REPLY_LIMIT 200
+// Messages lus au plus par @history, tous salons confondus: la lecture se fait sur le thread du réacteur
+#define HISTORY_SCAN_LIMIT 5000
+
+// Lecture du journal des messages pour @history: les messages d'un salon, envoyés au client
+typedef struct history_reply
+{
+    int sock;
+    const char *channel;
+    size_t count;
+    size_t scanned;
+    uint64_t last_sequence;
+} HistoryReply;
+
+/**
+ ** Sends a message read from the message log to the client, if it belongs to its channel.
+ * @param entry (const MsgLogEntry*) - The message; its bytes are the ones the members received.
+ * @param arg (void*) - The HistoryReply.
+ * @returns int - 1 once the reply or the scan limit is reached, 0 otherwise.
+ */
+static int replyHistory(const MsgLogEntry *entry, void *arg)
+{
+    HistoryReply *reply = (HistoryReply *)arg;
+
+    // The messages of the other channels count too: the next request resumes after them
+    reply->last_sequence = entry->sequence;
+    reply->scanned++;
+    if (strcmp(entry->channel, reply->channel) == 0)
+    {
+        send_client_data(reply->sock, entry->data, entry->length);
+        reply->count++;
+    }
+    return reply->count == HISTORY_REPLY_LIMIT || reply->scanned == HISTORY_SCAN_LIMIT;
+}
+
 /**
  ** Executes a command received from a client socket.
  * Parses the command, dispatches to the appropriate handler, and sends responses in French.
@@ -78,8 +87,13 @@ void privateMessage(int senderSock, const char *username, const char *msg)
  */
 void executeCommand(int sock, char *msg, int *shouldShutdown)
 {
-    char response[1024];
-    Command cmd = parseCommand(msg);
+    char response[2048];
+    CommandLine line;
+    Command cmd = commandLineParse(&line, msg);
+    Session *session = sessionGet(sock);
+
+    if (session != NULL)
+        atomic_fetch_add(&session->commands, 1);
 
     switch (cmd)
     {
@@ -90,48 +104,78 @@ void executeCommand(int sock, char *msg, int *shouldShutdown)
                  "@ping - Répond 'pong'\n"
                  "@msg <user> <msg> - Message privé\n"
                  "@connect <user> <pwd> - Connexion\n"
+                 "@password <ancien> <nouveau> - Change le mot de passe\n"
+                 "@create <salon> - Crée un salon et y entre\n"
+                 "@join <salon> - Entre dans un salon\n"
+                 "@leave - Quitte le salon pour revenir dans " CHANNEL_GENERAL "\n"
+                 "@history seq <n> | time <t> - Messages du salon depuis un numéro ou une date (secondes Unix)\n"
                  "@credits - Affiche les crédits\n"
-                 "@shutdown - Éteint le serveur\n");
-        send(sock, response, strlen(response), 0);
+                 "@shutdown - Éteint le serveur\n"
+                 "@stats - Statistiques du serveur (admin)\n"
+                 "@export - Exporte les comptes dans users.json (admin)\n");
+        send_client_data(sock, response, strlen(response));
         break;
     case PING:
-        send(sock, "pong", 4, 0);
+        send_client_data(sock, "pong", 4);
         break;
     case MSG:
     {
-        char user[MAX_USERNAME_LENGTH];
-        char message[1024];
-        sscanf(msg, "@msg %s %[^\n]", user, message);
-        privateMessage(sock, user, message);
+        StringView user;
+        bool has_user = commandLineNext(&line, &user);
+        StringView message = commandLineRest(&line);
+        if (!has_user || message.length == 0)
+        {
+            send_client_data(sock, "Commande invalide. Usage : @msg <user> <message>", 49);
+            break;
+        }
+        // The message has been read: the separator after the username can become its terminator
+        privateMessage(sock, stringViewTerminate(user), stringViewTerminate(message));
         break;
     }
     case CONNECT:
     {
-        char username[MAX_USERNAME_LENGTH];
-        char password[MAX_PASSWORD_LENGTH];
-        int parsed = sscanf(msg, "@connect %s %s", username, password);
-        if (parsed != 2)
+        StringView username;
+        StringView password;
+        if (!commandLineNext(&line, &username) || !commandLineNext(&line, &password) ||
+            username.length >= MAX_USERNAME_LENGTH || password.length >= MAX_PASSWORD_LENGTH)
         {
-            send(sock, "Commande invalide. Usage : @connect <username> <password>", 61, 0);
+            send_client_data(sock, "Commande invalide. Usage : @connect <username> <password>", 58);
             break;
         }
-        User *client = findUserByName(username);
-        if (client != NULL)
+        int status = loginUser(stringViewTerminate(username), stringViewTerminate(password), sock);
+        if (status == 0)
         {
-            if (strcmp(client->password, password) == 0)
-            {
-                client->authenticated = true;
-                client->socket_fd = sock;
-                send(sock, "Connexion réussie.", 19, 0);
-            }
-            else
-            {
-                send(sock, "Mot de passe incorrect.", 24, 0);
-            }
+            send_client_data(sock, "Connexion réussie.", 19);
+        }
+        else if (status == 1)
+        {
+            send_client_data(sock, "Mot de passe incorrect.", 24);
         }
         else
         {
-            send(sock, "Nom d'utilisateur non trouvé.", 30, 0);
+            send_client_data(sock, "Nom d'utilisateur non trouvé.", 30);
+        }
+        break;
+    }
+    case PASSWORD:
+    {
+        StringView oldPassword;
+        StringView newPassword;
+        if (!commandLineNext(&line, &oldPassword) || !commandLineNext(&line, &newPassword) ||
+            oldPassword.length >= MAX_PASSWORD_LENGTH || newPassword.length >= MAX_PASSWORD_LENGTH)
+        {
+            send_client_data(sock, "Commande invalide. Usage : @password <ancien> <nouveau>", 56);
+            break;
+        }
+        // On success, the confirmation is sent once the change is written in the journal
+        int status = changePassword(sock, stringViewTerminate(oldPassword), stringViewTerminate(newPassword));
+        if (status == 1)
+        {
+            send_client_data(sock, "Ancien mot de passe incorrect.", 31);
+        }
+        else if (status == -1)
+        {
+            send_client_data(sock, "Vous devez être connecté.", 28);
         }
         break;
     }
@@ -143,46 +187,199 @@ void executeCommand(int sock, char *msg, int *shouldShutdown)
         break;
     case SHUTDOWN:
     {
-        User *user = findUserBySocket(sock);
-        if (user != NULL && getRoleByName(user->name) == ADMIN)
+        if (sessionIsAdmin(sock))
         {
-            send(sock, "Arrêt du serveur...", 21, 0);
+            send_client_data(sock, "Arrêt du serveur...", 21);
             *shouldShutdown = 1;
         }
         else
         {
-            send(sock, "Commande réservée à l'admin.", 30, 0);
+            send_client_data(sock, "Commande réservée à l'admin.", 30);
+        }
+        break;
+    }
+    case STATS:
+    {
+        if (sessionIsAdmin(sock))
+        {
+            statsFormat(response, sizeof(response));
+
+            size_t length = strlen(response);
+            length += (size_t)snprintf(response + length, sizeof(response) - length, "Connectés: %zu, dont %zu admins\n",
+                                       bitsetCount(sessionOnline()), bitsetCount(sessionRole(ADMIN)));
+            snprintf(response + length, sizeof(response) - length, "Votre session: %lu commandes, %lu messages depuis %ld s\n",
+                     atomic_load(&session->commands), atomic_load(&session->messages), (long)(time(NULL) - session->login_time));
+            send_client_data(sock, response, strlen(response));
+        }
+        else
+        {
+            send_client_data(sock, "Commande réservée à l'admin.", 30);
+        }
+        break;
+    }
+    case EXPORT:
+    {
+        if (!sessionIsAdmin(sock))
+        {
+            send_client_data(sock, "Commande réservée à l'admin.", 30);
+        }
+        else if (saveUsersToJson(USERS_FILE) == 0)
+        {
+            send_client_data(sock, "Comptes exportés dans users.json.", 35);
+        }
+        else
+        {
+            send_client_data(sock, "Erreur lors de l'export des comptes.", 37);
+        }
+        break;
+    }
+    case CREATE:
+    case JOIN:
+    {
+        StringView name;
+        Channel *channel = NULL;
+        if (!commandLineNext(&line, &name) || !channelNameIsValid(stringViewTerminate(name)))
+        {
+            send_client_data(sock, "Nom de salon invalide (lettres, chiffres, - et _, 31 au plus).", 63);
+            break;
+        }
+        if (cmd == CREATE)
+        {
+            int status = channelCreate(name.data, &channel);
+            if (status == 1)
+                snprintf(response, sizeof(response), "Le salon '%s' existe déjà.", name.data);
+            else if (status == -1)
+                snprintf(response, sizeof(response), "Impossible de créer le salon '%s'.", name.data);
+        }
+        else if ((channel = channelFind(name.data)) == NULL)
+        {
+            snprintf(response, sizeof(response), "Salon '%s' introuvable.", name.data);
+        }
+        if (channel != NULL)
+        {
+            if (channelJoin(channel, sock) == 0)
+                snprintf(response, sizeof(response), "Vous êtes dans le salon '%s'.", channel->name);
+            else
+                snprintf(response, sizeof(response), "Impossible d'entrer dans le salon '%s'.", channel->name);
+        }
+        send_client_data(sock, response, strlen(response) + 1);
+        break;
+    }
+    case LEAVE:
+    {
+        Channel *current = channelOf(sock);
+        Channel *general = channelFind(CHANNEL_GENERAL);
+        if (current == general)
+        {
+            send_client_data(sock, "Vous êtes déjà dans le salon " CHANNEL_GENERAL ".", 41);
+        }
+        else if (channelJoin(general, sock) == 0)
+        {
+            snprintf(response, sizeof(response), "Vous avez quitté le salon '%s'.", current != NULL ? current->name : "");
+            send_client_data(sock, response, strlen(response) + 1);
+        }
+        else
+        {
+            send_client_data(sock, "Impossible de revenir dans le salon " CHANNEL_GENERAL ".", 45);
         }
         break;
     }
     case UPLOAD:
     {
-        char filename[100];
-        if (sscanf(msg + 8, "%99s", filename) == 1)
+        StringView filename;
+        if (commandLineNext(&line, &filename))
         {
-            if (strstr(filename, "..") != NULL)
+            // upload() reads the filename and what follows it (the size, for v2 clients)
+            StringView rest = commandLineRest(&line);
+            StringView argument = {filename.data, (size_t)(rest.data + rest.length - filename.data)};
+
+            if (memmem(filename.data, filename.length, "..", 2) != NULL)
             {
-                send(sock, "Nom de fichier invalide.\n", 26, 0);
+                send_client_data(sock, "Nom de fichier invalide.\n", 26);
             }
             else
             {
-                upload(sock, filename);
+                upload(sock, stringViewTerminate(argument));
             }
         }
         else
         {
-            send(sock, "Nom de fichier manquant.\n", 26, 0);
+            send_client_data(sock, "Nom de fichier manquant.\n", 26);
         }
         break;
     }
     case DOWNLOAD:
         download(sock, msg);
         break;
+    case HISTORY:
+    {
+        StringView mode;
+        StringView value;
+        Channel *channel = channelOf(sock);
+        if (!commandLineNext(&line, &mode) || !commandLineNext(&line, &value))
+        {
+            send_client_data(sock, "Commande invalide. Usage : @history seq <n> | time <t>", 55);
+            break;
+        }
+        if (!msglogEnabled())
+        {
+            send_client_data(sock, "Le journal des messages n'est pas activé.", 43);
+            break;
+        }
+        if (channel == NULL)
+        {
+            send_client_data(sock, "Vous n'êtes dans aucun salon.", 31);
+            break;
+        }
+
+        char *end;
+        int by_time = mode.length == 4 && strncmp(mode.data, "time", 4) == 0;
+        unsigned long long start = strtoull(stringViewTerminate(value), &end, 10);
+        if ((!by_time && !(mode.length == 3 && strncmp(mode.data, "seq", 3) == 0)) || *end != '\0')
+        {
+            send_client_data(sock, "Commande invalide. Usage : @history seq <n> | time <t>", 55);
+            break;
+        }
+
+        HistoryReply reply = {sock, channel->name, 0, 0, 0};
+        if (by_time)
+            msglogReadFromTime((time_t)start, replyHistory, &reply);
+        else
+            msglogReadFromSequence(start, replyHistory, &reply);
+
+        if (reply.count == HISTORY_REPLY_LIMIT || reply.scanned == HISTORY_SCAN_LIMIT)
+            snprintf(response, sizeof(response), "Historique: %zu messages, suite avec @history seq %llu",
+                     reply.count, (unsigned long long)reply.last_sequence + 1);
+        else
+            snprintf(response, sizeof(response), "Historique: %zu messages.", reply.count);
+        send_client_data(sock, response, strlen(response) + 1);
+        break;
+    }
     default:
     {
-        char broadcastMsg[1024];
-        snprintf(broadcastMsg, sizeof(broadcastMsg), "Message de %d : %s", sock, msg);
-        sendAllClients(broadcastMsg);
+        // Only the members of the sender's channel receive the message
+        Channel *channel = channelOf(sock);
+        if (channel == NULL)
+        {
+            send_client_data(sock, "Vous n'êtes dans aucun salon.", 31);
+            break;
+        }
+
+        // Formatted once: every recipient queue points to these two buffers
+        MessageBuffer *parts[2];
+        if (strcmp(channel->name, CHANNEL_GENERAL) == 0)
+            parts[0] = bufferPrintf("Message de %d : ", sock);
+        else
+            parts[0] = bufferPrintf("[%s] Message de %d : ", channel->name, sock);
+        parts[1] = bufferCreate(msg, strlen(msg) + 1);
+
+        if (parts[0] != NULL && parts[1] != NULL)
+            channelBroadcast(channel, parts, 2);
+        if (session != NULL)
+            atomic_fetch_add(&session->messages, 1);
+
+        bufferRelease(parts[0]);
+        bufferRelease(parts[1]);
         break;
     }
     }
@@ -0,0 +1,154 @@
+#include <ctype.h>
+#include "commandline.h"
+
+#define COMMAND_SLOTS 32
+
+// Position d'un nom de commande (sans '@') dans la table, d'après sa première lettre, sa dernière
+// lettre et sa longueur. La formule ne donne aucune collision pour les noms de la table: une
+// collision ajoutée serait signalée à la compilation par -Woverride-init (-Wextra).
+#define COMMAND_SLOT(first, last, length) \
+    ((((unsigned)((first) | 0x20) * 4) + ((unsigned)((last) | 0x20) * 3) + ((unsigned)(length) * 6)) % COMMAND_SLOTS)
+#define COMMAND_ENTRY(first, last, name, command) \
+    [COMMAND_SLOT(first, last, sizeof(name) - 1)] = {name, sizeof(name) - 1, command}
+
+typedef struct command_entry
+{
+    const char *name;
+    size_t length;
+    Command command;
+} CommandEntry;
+
+static const CommandEntry command_table[COMMAND_SLOTS] = {
+    COMMAND_ENTRY('c', 'd', "command", COMMAND),
+    COMMAND_ENTRY('h', 'p', "help", HELP),
+    COMMAND_ENTRY('p', 'g', "ping", PING),
+    COMMAND_ENTRY('m', 'g', "msg", MSG),
+    COMMAND_ENTRY('c', 't', "connect", CONNECT),
+    COMMAND_ENTRY('c', 's', "credits", CREDITS),
+    COMMAND_ENTRY('s', 'n', "shutdown", SHUTDOWN),
+    COMMAND_ENTRY('c', 'e', "create", CREATE),
+    COMMAND_ENTRY('j', 'n', "join", JOIN),
+    COMMAND_ENTRY('l', 'e', "leave", LEAVE),
+    COMMAND_ENTRY('u', 'd', "upload", UPLOAD),
+    COMMAND_ENTRY('d', 'd', "download", DOWNLOAD),
+    COMMAND_ENTRY('s', 's', "stats", STATS),
+    COMMAND_ENTRY('p', 'd', "password", PASSWORD),
+    COMMAND_ENTRY('e', 't', "export", EXPORT),
+    COMMAND_ENTRY('h', 'y', "history", HISTORY),
+};
+
+/**
+ ** Returns the length of the first word of a string: up to whitespace or its end.
+ * @param text (const char*) - The string.
+ * @returns size_t - The length of the word.
+ */
+static size_t wordLength(const char *text)
+{
+    size_t length = 0;
+
+    while (text[length] != '\0' && !isspace((unsigned char)text[length]))
+        length++;
+    return length;
+}
+
+/**
+ ** Looks a command word up in the dispatch table.
+ * @param word (const char*) - The word, '@' included.
+ * @param length (size_t) - Its length.
+ * @returns Command - The command, or UNKNOWN if the word is not exactly one of them.
+ */
+static Command lookupCommand(const char *word, size_t length)
+{
+    if (length < 2 || word[0] != '@')
+        return UNKNOWN;
+
+    const char *name = word + 1;
+    size_t name_length = length - 1;
+    const CommandEntry *entry = &command_table[COMMAND_SLOT(name[0], name[name_length - 1], name_length)];
+
+    if (entry->name == NULL || entry->length != name_length)
+        return UNKNOWN;
+
+    // The names are lowercase letters: setting bit 0x20 matches both cases of a letter, and nothing else
+    for (size_t i = 0; i < name_length; i++)
+    {
+        if ((name[i] | 0x20) != entry->name[i])
+            return UNKNOWN;
+    }
+    return entry->command;
+}
+
+/**
+ ** Parses a command string and returns the corresponding Command enum.
+ * The first word must be a command name exactly, in any case: "@helpful" is not "@help".
+ * @param msg (const char*) - The command string to parse.
+ * @returns Command - The parsed command type.
+ */
+Command parseCommand(const char *msg)
+{
+    return lookupCommand(msg, wordLength(msg));
+}
+
+/**
+ ** Recognizes the command of a received line and prepares the reading of its arguments.
+ * @param line (CommandLine*) - Receives the command and the position of the arguments.
+ * @param msg (char*) - The received line; the arguments will point into it.
+ * @returns Command - The command, or UNKNOWN for a plain message.
+ */
+Command commandLineParse(CommandLine *line, char *msg)
+{
+    size_t length = wordLength(msg);
+
+    line->command = lookupCommand(msg, length);
+    line->cursor = msg + length;
+    return line->command;
+}
+
+/**
+ ** Reads the next whitespace-separated argument of a line, without copying it.
+ * @param line (CommandLine*) - The line.
+ * @param argument (StringView*) - Receives the argument.
+ * @returns bool - false if the line has no argument left.
+ */
+bool commandLineNext(CommandLine *line, StringView *argument)
+{
+    while (isspace((unsigned char)*line->cursor))
+        line->cursor++;
+
+    argument->data = line->cursor;
+    argument->length = wordLength(line->cursor);
+    line->cursor += argument->length;
+    return argument->length > 0;
+}
+
+/**
+ ** Returns the rest of the line, from its next argument to the end of the line, without copying it.
+ * @param line (CommandLine*) - The line; nothing is left to read afterwards.
+ * @returns StringView - The rest, empty if there is none.
+ */
+StringView commandLineRest(CommandLine *line)
+{
+    StringView rest;
+
+    while (isspace((unsigned char)*line->cursor))
+        line->cursor++;
+
+    rest.data = line->cursor;
+    rest.length = 0;
+    while (rest.data[rest.length] != '\0' && rest.data[rest.length] != '\n')
+        rest.length++;
+    line->cursor += rest.length;
+    return rest;
+}
+
+/**
+ ** Ends a view with '\0' in place, so that it can be passed as a C string. The byte following
+ * the view, a separator or the end of the line, is overwritten: what follows must have been read.
+ * @param view (StringView) - A view returned by commandLineNext or commandLineRest.
+ * @returns char* - The view as a C string.
+ */
+char *stringViewTerminate(StringView view)
+{
+    view.data[view.length] = '\0';
+    return view.data;
+}
@@ -0,0 +1,53 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Enumération des types de commandes
+typedef enum command
+{
+    COMMAND,
+    PING,
+    MSG,
+    HELP,
+    CREDITS,
+    CONNECT,
+    SHUTDOWN,
+    CREATE,
+    JOIN,
+    LEAVE,
+    UPLOAD,
+    DOWNLOAD,
+    STATS,
+    PASSWORD,
+    EXPORT,
+    HISTORY,
+    UNKNOWN,
+} Command;
+
+// Portion de la ligne reçue, sans copie; elle n'est pas terminée par '\0'
+typedef struct string_view
+{
+    char *data;
+    size_t length;
+} StringView;
+
+/*
+ * Ligne de commande découpée au fur et à mesure, directement dans le tampon de réception:
+ * le nom de la commande est reconnu par une table à hachage parfait, exacte et insensible
+ * à la casse, puis les arguments sont rendus un par un sous forme de StringView.
+ */
+typedef struct command_line
+{
+    Command command;
+    char *cursor;
+} CommandLine;
+
+Command parseCommand(const char *msg);
+Command commandLineParse(CommandLine *line, char *msg);
+bool commandLineNext(CommandLine *line, StringView *argument);
+StringView commandLineRest(CommandLine *line);
+char *stringViewTerminate(StringView view);
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "config.h"
+
+ServerConfig server_config = {
+    .reactor_count = 1,
+    .pin_cpus = 0,
+    .cpu_count = 0,
+    .queue_limit = 1024 * 1024,
+    .global_queue_limit = 256 * 1024 * 1024,
+    .slow_policy = POLICY_DROP_OLDEST,
+    .transfer_workers = 4,
+    .transfer_queue = 64,
+    .log_compact_records = 10000,
+    .history_size = 100,
+    .history_bytes = 256 * 1024,
+    .history_replay = 20,
+    .msglog_directory = NULL,
+    .msglog_segment_size = 64 * 1024 * 1024,
+    .msglog_retention_bytes = 1024 * 1024 * 1024,
+    .msglog_retention_hours = 7 * 24,
+};
+
+static const char *slow_policy_names[] = {"drop-oldest", "drop-new", "disconnect"};
+
+/**
+ ** Prints the command line usage of the server.
+ * @param program (const char*) - The name of the executable.
+ * @returns void
+ */
+static void printUsage(const char *program)
+{
+    fprintf(stderr,
+            "Utilisation: %s [options]\n"
+            "  -t, --threads <n>      Nombre de reactors (un listener SO_REUSEPORT chacun)\n"
+            "  -a, --affinity <cpus>  Épingle les reactors sur des coeurs: 'auto' ou liste '0,2,4'\n"
+            "  -q, --queue-limit <n>  Octets en attente maximum par client (suffixes k, m, g)\n"
+            "  -g, --global-queue-limit <n>\n"
+            "                         Octets en attente maximum pour tout le serveur\n"
+            "  -p, --slow-policy <p>  drop-oldest, drop-new ou disconnect quand une limite est atteinte\n"
+            "  -w, --transfer-workers <n>\n"
+            "                         Nombre de transferts de fichiers simultanés\n"
+            "  -Q, --transfer-queue <n>\n"
+            "                         Transferts en attente maximum avant refus\n"
+            "  -c, --compact-after <n>\n"
+            "                         Enregistrements du journal des comptes avant compaction\n"
+            "  -H, --history <n>      Messages conservés par salon (0 pour aucun)\n"
+            "  -b, --history-bytes <n>\n"
+            "                         Octets de messages conservés au plus par salon (suffixes k, m, g)\n"
+            "  -r, --replay <n>       Messages de l'historique renvoyés à l'entrée dans un salon\n"
+            "  -L, --message-log <dir>\n"
+            "                         Journal durable des messages des salons dans ce répertoire\n"
+            "  -S, --segment-size <n> Taille d'un segment du journal des messages (suffixes k, m, g)\n"
+            "  -R, --retention-bytes <n>\n"
+            "                         Taille maximum du journal des messages\n"
+            "  -T, --retention-hours <n>\n"
+            "                         Âge maximum des messages du journal (0 pour aucun)\n"
+            "  -h, --help             Affiche cette aide\n",
+            program);
+}
+
+/**
+ ** Returns the command line name of a slow consumer policy.
+ * @param policy (SlowPolicy) - The policy.
+ * @returns const char* - Its name.
+ */
+const char *slowPolicyName(SlowPolicy policy)
+{
+    return slow_policy_names[policy];
+}
+
+/**
+ ** Parses a byte count with an optional k, m or g suffix.
+ * @param text (const char*) - The value given on the command line.
+ * @param size (size_t*) - Receives the number of bytes.
+ * @returns int - 0 on success, -1 if the value is invalid.
+ */
+static int parseSize(const char *text, size_t *size)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (end == text)
+        return -1;
+
+    switch (*end)
+    {
+    case 'g':
+    case 'G':
+        value *= 1024;
+        /* fall through */
+    case 'm':
+    case 'M':
+        value *= 1024;
+        /* fall through */
+    case 'k':
+    case 'K':
+        value *= 1024;
+        end++;
+        break;
+    default:
+        break;
+    }
+    if (*end != '\0' || value == 0)
+        return -1;
+
+    *size = (size_t)value;
+    return 0;
+}
+
+/**
+ ** Parses a CPU list such as "0,2,4" or the keyword "auto".
+ * @param list (const char*) - The CPU list given on the command line.
+ * @returns int - 0 on success, -1 if the list is invalid.
+ */
+static int parseCpuList(const char *list)
+{
+    server_config.pin_cpus = 1;
+    server_config.cpu_count = 0;
+
+    if (strcmp(list, "auto") == 0)
+        return 0;
+
+    const char *cursor = list;
+
+    while (*cursor != '\0')
+    {
+        char *end;
+        long cpu = strtol(cursor, &end, 10);
+
+        if (end == cursor || cpu < 0 || server_config.cpu_count >= MAX_REACTORS)
+            return -1;
+
+        server_config.cpus[server_config.cpu_count++] = (int)cpu;
+        cursor = end;
+
+        if (*cursor == ',')
+            cursor++;
+        else if (*cursor != '\0')
+            return -1;
+    }
+    return server_config.cpu_count > 0 ? 0 : -1;
+}
+
+/**
+ ** Reads the server configuration from the command line arguments.
+ * @param argc (int) - Argument count.
+ * @param argv (char**) - Argument values.
+ * @returns int - 0 on success, -1 if the arguments are invalid.
+ */
+int parseConfig(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"affinity", required_argument, NULL, 'a'},
+        {"queue-limit", required_argument, NULL, 'q'},
+        {"global-queue-limit", required_argument, NULL, 'g'},
+        {"slow-policy", required_argument, NULL, 'p'},
+        {"transfer-workers", required_argument, NULL, 'w'},
+        {"transfer-queue", required_argument, NULL, 'Q'},
+        {"compact-after", required_argument, NULL, 'c'},
+        {"history", required_argument, NULL, 'H'},
+        {"history-bytes", required_argument, NULL, 'b'},
+        {"replay", required_argument, NULL, 'r'},
+        {"message-log", required_argument, NULL, 'L'},
+        {"segment-size", required_argument, NULL, 'S'},
+        {"retention-bytes", required_argument, NULL, 'R'},
+        {"retention-hours", required_argument, NULL, 'T'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:a:q:g:p:w:Q:c:H:b:r:L:S:R:T:h", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            server_config.reactor_count = atoi(optarg);
+            if (server_config.reactor_count <= 0 || server_config.reactor_count > MAX_REACTORS)
+            {
+                fprintf(stderr, "Nombre de reactors invalide (1 à %d)\n", MAX_REACTORS);
+                return -1;
+            }
+            break;
+        case 'a':
+            if (parseCpuList(optarg) != 0)
+            {
+                fprintf(stderr, "Liste de CPU invalide: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'q':
+        case 'g':
+        case 'b':
+        case 'S':
+        case 'R':
+        {
+            size_t *limit = opt == 'q'   ? &server_config.queue_limit
+                            : opt == 'g' ? &server_config.global_queue_limit
+                            : opt == 'b' ? &server_config.history_bytes
+                            : opt == 'S' ? &server_config.msglog_segment_size
+                                         : &server_config.msglog_retention_bytes;
+            if (parseSize(optarg, limit) != 0)
+            {
+                fprintf(stderr, "Limite invalide: %s\n", optarg);
+                return -1;
+            }
+            break;
+        }
+        case 'w':
+        case 'Q':
+        case 'c':
+        {
+            int *count = opt == 'w'   ? &server_config.transfer_workers
+                         : opt == 'Q' ? &server_config.transfer_queue
+                                      : &server_config.log_compact_records;
+            *count = atoi(optarg);
+            if (*count <= 0)
+            {
+                fprintf(stderr, "Valeur invalide: %s\n", optarg);
+                return -1;
+            }
+            break;
+        }
+        case 'L':
+            server_config.msglog_directory = optarg;
+            break;
+        case 'H':
+        case 'r':
+        case 'T':
+        {
+            // Zero disables the history, its replay, or the age limit of the message log
+            int *count = opt == 'H'   ? &server_config.history_size
+                         : opt == 'r' ? &server_config.history_replay
+                                      : &server_config.msglog_retention_hours;
+            char *end;
+            long value = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || value < 0 || value > 1000000)
+            {
+                fprintf(stderr, "Valeur invalide: %s\n", optarg);
+                return -1;
+            }
+            *count = (int)value;
+            break;
+        }
+        case 'p':
+        {
+            int found = 0;
+            for (int i = 0; i < (int)(sizeof(slow_policy_names) / sizeof(slow_policy_names[0])); i++)
+            {
+                if (strcmp(optarg, slow_policy_names[i]) == 0)
+                {
+                    server_config.slow_policy = (SlowPolicy)i;
+                    found = 1;
+                }
+            }
+            if (!found)
+            {
+                fprintf(stderr, "Politique inconnue: %s\n", optarg);
+                return -1;
+            }
+            break;
+        }
+        default:
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    return 0;
+}
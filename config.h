@@ -0,0 +1,44 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+
+#define SERVER_PORT 31473
+#define MAX_REACTORS 64
+
+// Que faire quand la file d'envoi d'un client lent est pleine
+typedef enum
+{
+    POLICY_DROP_OLDEST,
+    POLICY_DROP_NEW,
+    POLICY_DISCONNECT,
+} SlowPolicy;
+
+// Configuration du serveur, lue depuis la ligne de commande
+typedef struct server_config
+{
+    int reactor_count;
+    int pin_cpus;
+    int cpus[MAX_REACTORS];
+    int cpu_count;
+    size_t queue_limit;
+    size_t global_queue_limit;
+    SlowPolicy slow_policy;
+    int transfer_workers;
+    int transfer_queue;
+    int log_compact_records;
+    int history_size;
+    size_t history_bytes;
+    int history_replay;
+    const char *msglog_directory;
+    size_t msglog_segment_size;
+    size_t msglog_retention_bytes;
+    int msglog_retention_hours;
+} ServerConfig;
+
+extern ServerConfig server_config;
+
+int parseConfig(int argc, char **argv);
+const char *slowPolicyName(SlowPolicy policy);
+
+#endif
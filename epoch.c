@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "epoch.h"
+
+// État d'un thread lecteur. Les enregistrements ne sont jamais libérés: les threads du serveur vivent aussi longtemps que lui.
+typedef struct epoch_record
+{
+    atomic_ulong epoch;
+    atomic_bool active;
+    int nesting;
+    struct epoch_record *next;
+} EpochRecord;
+
+// Objet retiré, en attente de libération
+typedef struct retired
+{
+    void *pointer;
+    void (*release)(void *);
+    unsigned long epoch;
+    struct retired *next;
+} Retired;
+
+static atomic_ulong global_epoch = 0;
+static _Atomic(EpochRecord *) records = NULL;
+static __thread EpochRecord *thread_record = NULL;
+
+static pthread_mutex_t retired_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Retired *retired = NULL;
+static size_t retired_count = 0;
+
+/**
+ ** Returns the record of the calling thread, creating it on first use.
+ * @returns EpochRecord* - The record, or NULL if memory is exhausted.
+ */
+static EpochRecord *threadRecord(void)
+{
+    if (thread_record != NULL)
+        return thread_record;
+
+    EpochRecord *record = calloc(1, sizeof(EpochRecord));
+
+    if (record == NULL)
+    {
+        perror("calloc epoch record");
+        return NULL;
+    }
+
+    record->next = atomic_load(&records);
+    while (!atomic_compare_exchange_weak(&records, &record->next, record))
+        ;
+    thread_record = record;
+    return record;
+}
+
+/**
+ ** Marks the calling thread as reading. Calls may be nested.
+ * @returns void
+ */
+void epochEnter(void)
+{
+    EpochRecord *record = threadRecord();
+
+    // Reading without a record would let writers free what the thread is reading
+    if (record == NULL)
+        abort();
+    if (record->nesting++ > 0)
+        return;
+
+    // A stale epoch only delays reclamation; the fence keeps the reads of the structure after the announcement
+    atomic_store_explicit(&record->active, true, memory_order_relaxed);
+    atomic_store_explicit(&record->epoch, atomic_load_explicit(&global_epoch, memory_order_relaxed), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ ** Marks the calling thread as no longer reading.
+ * @returns void
+ */
+void epochExit(void)
+{
+    EpochRecord *record = thread_record;
+
+    if (--record->nesting > 0)
+        return;
+    atomic_store_explicit(&record->active, false, memory_order_release);
+}
+
+/**
+ ** Advances the global epoch if every active reader has seen the current one.
+ * @returns unsigned long - The global epoch after the attempt.
+ */
+static unsigned long tryAdvance(void)
+{
+    unsigned long epoch = atomic_load(&global_epoch);
+
+    for (EpochRecord *record = atomic_load(&records); record != NULL; record = record->next)
+    {
+        if (atomic_load(&record->active) && atomic_load(&record->epoch) != epoch)
+            return epoch;
+    }
+    if (atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1))
+        return epoch + 1;
+    return epoch;
+}
+
+/**
+ ** Hands an object removed from a shared structure over for deferred release.
+ * Readers may still hold it: it is released once none of them can.
+ * @param pointer (void*) - The object, already unreachable for new readers.
+ * @param release (void (*)(void*)) - Releases the object, for instance free.
+ * @returns void
+ */
+void epochRetire(void *pointer, void (*release)(void *))
+{
+    Retired *item = malloc(sizeof(Retired));
+
+    if (item == NULL)
+    {
+        // Leaking the object is the only safe option left
+        perror("malloc epoch retire");
+        return;
+    }
+    item->pointer = pointer;
+    item->release = release;
+
+    pthread_mutex_lock(&retired_mutex);
+    item->epoch = atomic_load(&global_epoch);
+    item->next = retired;
+    retired = item;
+    retired_count++;
+
+    Retired *ready = NULL;
+
+    if (retired_count >= EPOCH_RECLAIM_THRESHOLD)
+    {
+        unsigned long epoch = tryAdvance();
+
+        // An object retired in epoch e is unreachable for every reader once the epoch reaches e + 2
+        for (Retired **link = &retired; *link != NULL;)
+        {
+            Retired *current = *link;
+
+            if (current->epoch + 2 <= epoch)
+            {
+                *link = current->next;
+                current->next = ready;
+                ready = current;
+                retired_count--;
+            }
+            else
+            {
+                link = &current->next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&retired_mutex);
+
+    while (ready != NULL)
+    {
+        Retired *next = ready->next;
+
+        ready->release(ready->pointer);
+        free(ready);
+        ready = next;
+    }
+}
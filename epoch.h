@@ -0,0 +1,17 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/*
+ * Récupération mémoire par époques, pour les structures lues sans verrou.
+ * Un lecteur encadre ses accès par epochEnter()/epochExit(). Un écrivain qui retire un objet
+ * de la structure le confie à epochRetire(): il n'est libéré qu'une fois que tous les lecteurs
+ * présents au moment du retrait sont sortis, c'est-à-dire deux avancées de l'époque globale plus tard.
+ */
+
+#define EPOCH_RECLAIM_THRESHOLD 64
+
+void epochEnter(void);
+void epochExit(void);
+void epochRetire(void *pointer, void (*release)(void *));
+
+#endif
@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include "history.h"
+#include "epoch.h"
+#include "stats.h"
+
+/**
+ ** Drops the history's reference to a buffer, once the readers that may hold it are gone.
+ * @param pointer (void*) - The MessageBuffer.
+ * @returns void
+ */
+static void releaseRetired(void *pointer)
+{
+    bufferRelease((MessageBuffer *)pointer);
+}
+
+/**
+ ** Allocates an empty history.
+ * @param history (History*) - The history to initialize.
+ * @param capacity (size_t) - The maximum number of messages kept.
+ * @param byte_limit (size_t) - The maximum number of message bytes kept.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+int historyInit(History *history, size_t capacity, size_t byte_limit)
+{
+    history->slots = calloc(capacity, sizeof(HistorySlot));
+
+    if (history->slots == NULL)
+        return -1;
+
+    history->capacity = capacity;
+    history->byte_limit = byte_limit;
+    atomic_init(&history->head, 0);
+    atomic_init(&history->tail, 0);
+    history->bytes = 0;
+    return 0;
+}
+
+/**
+ ** Removes the oldest message of a history. The caller must be the only writer.
+ * @param history (History*) - The history, not empty.
+ * @returns void
+ */
+static void evictOldest(History *history)
+{
+    unsigned long tail = atomic_load(&history->tail);
+    HistorySlot *slot = &history->slots[tail % history->capacity];
+
+    // Readers check the sequence again after taking their references: they drop this message
+    atomic_store(&slot->sequence, 0);
+    atomic_store(&history->tail, tail + 1);
+
+    for (int i = 0; i < HISTORY_PARTS; i++)
+    {
+        MessageBuffer *buffer = atomic_exchange(&slot->parts[i], NULL);
+
+        if (buffer != NULL)
+            epochRetire(buffer, releaseRetired);
+    }
+    history->bytes -= slot->bytes;
+    atomic_fetch_sub(&server_stats.history_messages, 1);
+    atomic_fetch_sub(&server_stats.history_bytes, (long)slot->bytes);
+    slot->bytes = 0;
+}
+
+/**
+ ** Appends a message to a history, taking a reference to each of its buffers. The oldest messages
+ * make room when the history is full. A message larger than the byte limit is not kept.
+ * Writers must be serialized by the caller.
+ * @param history (History*) - The history.
+ * @param parts (MessageBuffer**) - The buffers of the message, as sent to the members.
+ * @param part_count (int) - The number of buffers, at most HISTORY_PARTS.
+ * @returns void
+ */
+void historyAppend(History *history, MessageBuffer **parts, int part_count)
+{
+    size_t bytes = 0;
+
+    if (history->capacity == 0 || part_count > HISTORY_PARTS)
+        return;
+    for (int i = 0; i < part_count; i++)
+        bytes += parts[i]->length;
+    if (bytes > history->byte_limit)
+        return;
+
+    unsigned long head = atomic_load(&history->head);
+
+    while (head != atomic_load(&history->tail) &&
+           (head - atomic_load(&history->tail) >= history->capacity || history->bytes + bytes > history->byte_limit))
+        evictOldest(history);
+
+    HistorySlot *slot = &history->slots[head % history->capacity];
+
+    atomic_store(&slot->part_count, part_count);
+    for (int i = 0; i < part_count; i++)
+        atomic_store(&slot->parts[i], bufferRetain(parts[i]));
+    slot->bytes = bytes;
+    history->bytes += bytes;
+    atomic_store(&slot->sequence, head + 1);
+    atomic_store(&history->head, head + 1);
+
+    atomic_fetch_add(&server_stats.history_messages, 1);
+    atomic_fetch_add(&server_stats.history_bytes, (long)bytes);
+}
+
+/**
+ ** Copies the last messages of a history, oldest first, without locking out the writer.
+ * A message replaced while it is read is skipped.
+ * @param history (History*) - The history.
+ * @param count (size_t) - The maximum number of messages.
+ * @param messages (HistoryMessage*) - Receives the messages, room for count of them.
+ * @returns size_t - The number of messages copied; each must be released with historyMessageRelease.
+ */
+size_t historyLast(History *history, size_t count, HistoryMessage *messages)
+{
+    size_t copied = 0;
+
+    if (history->capacity == 0)
+        return 0;
+
+    epochEnter();
+
+    unsigned long head = atomic_load(&history->head);
+    unsigned long tail = atomic_load(&history->tail);
+    unsigned long first = head - tail > count ? head - count : tail;
+
+    for (unsigned long sequence = first; sequence != head; sequence++)
+    {
+        HistorySlot *slot = &history->slots[sequence % history->capacity];
+        HistoryMessage *message = &messages[copied];
+
+        if (atomic_load(&slot->sequence) != sequence + 1)
+            continue;
+
+        message->part_count = atomic_load(&slot->part_count);
+        for (int i = 0; i < message->part_count; i++)
+        {
+            // A buffer retired by the writer stays referenced until this thread leaves its epoch
+            MessageBuffer *buffer = atomic_load(&slot->parts[i]);
+            message->parts[i] = buffer != NULL ? bufferRetain(buffer) : NULL;
+        }
+
+        if (atomic_load(&slot->sequence) != sequence + 1)
+        {
+            historyMessageRelease(message);
+            continue;
+        }
+        copied++;
+    }
+
+    epochExit();
+    return copied;
+}
+
+/**
+ ** Releases the references of a message copied by historyLast.
+ * @param message (HistoryMessage*) - The message.
+ * @returns void
+ */
+void historyMessageRelease(HistoryMessage *message)
+{
+    for (int i = 0; i < message->part_count; i++)
+        bufferRelease(message->parts[i]);
+    message->part_count = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "buffer.h"
+
+// Nombre maximum de tampons d'un message conservé (préfixe et texte)
+#define HISTORY_PARTS 2
+
+// Message conservé: sequence vaut 0 pendant son remplacement, sinon son numéro + 1
+typedef struct history_slot
+{
+    atomic_ulong sequence;
+    atomic_int part_count;
+    _Atomic(MessageBuffer *) parts[HISTORY_PARTS];
+    size_t bytes;
+} HistorySlot;
+
+// Copie d'un message de l'historique: une référence par tampon, à rendre avec historyMessageRelease
+typedef struct history_message
+{
+    MessageBuffer *parts[HISTORY_PARTS];
+    int part_count;
+} HistoryMessage;
+
+/*
+ * Historique d'un salon: anneau des derniers messages, dans les tampons partagés déjà envoyés aux
+ * membres. Borné en nombre de messages et en octets: les plus anciens sont retirés pour faire place.
+ * Les écrivains sont sérialisés par l'appelant (le verrou du salon); les lecteurs ne prennent aucun
+ * verrou. Un lecteur qui croise le remplacement d'un message l'ignore, et les tampons retirés ne sont
+ * libérés qu'à la sortie des lecteurs (epoch.h).
+ */
+typedef struct history
+{
+    HistorySlot *slots;
+    size_t capacity;
+    size_t byte_limit;
+    atomic_ulong head;
+    atomic_ulong tail;
+    size_t bytes;
+} History;
+
+int historyInit(History *history, size_t capacity, size_t byte_limit);
+void historyAppend(History *history, MessageBuffer **parts, int part_count);
+size_t historyLast(History *history, size_t count, HistoryMessage *messages);
+void historyMessageRelease(HistoryMessage *message);
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "jsonstream.h"
+#include "arena.h"
+
+// Position dans le tableau
+typedef enum
+{
+    STREAM_BEFORE_ARRAY,
+    STREAM_FIRST_ELEMENT,
+    STREAM_ELEMENT,
+    STREAM_AFTER_ELEMENT,
+    STREAM_DONE,
+} StreamState;
+
+// Fenêtre sur le fichier: buffer[start..length) n'a pas encore été consommé
+typedef struct json_stream
+{
+    int fd;
+    Arena arena;
+    char *buffer;
+    size_t capacity;
+    size_t start;
+    size_t length;
+    int eof;
+} JsonStream;
+
+/**
+ ** Reads the next chunk after the unconsumed bytes, which are first moved to the start of the buffer.
+ * The buffer grows only when a single element does not fit in it.
+ * @param stream (JsonStream*) - The stream.
+ * @returns int - 0 on success (possibly reaching the end of the file), -1 on error.
+ */
+static int streamFill(JsonStream *stream)
+{
+    size_t pending = stream->length - stream->start;
+
+    memmove(stream->buffer, stream->buffer + stream->start, pending);
+    stream->start = 0;
+    stream->length = pending;
+
+    if (stream->capacity - pending < JSON_STREAM_CHUNK)
+    {
+        size_t capacity = pending + JSON_STREAM_CHUNK;
+
+        if (pending > JSON_STREAM_MAX_ELEMENT)
+        {
+            fprintf(stderr, "Élément JSON trop grand (plus de %d octets)\n", JSON_STREAM_MAX_ELEMENT);
+            return -1;
+        }
+
+        char *buffer = realloc(stream->buffer, capacity);
+
+        if (buffer == NULL)
+            return -1;
+        stream->buffer = buffer;
+        stream->capacity = capacity;
+    }
+
+    ssize_t received = read(stream->fd, stream->buffer + stream->length, stream->capacity - stream->length);
+
+    if (received < 0)
+    {
+        perror("read JSON");
+        return -1;
+    }
+    if (received == 0)
+        stream->eof = 1;
+    stream->length += received;
+    return 0;
+}
+
+/**
+ ** Parses the element at the start of the window with cJSON, into the arena of the stream.
+ * An element may be cut by the end of the window: it is then parsed again once more bytes are read.
+ * @param stream (JsonStream*) - The stream.
+ * @param element (cJSON**) - Receives the element.
+ * @returns int - 1 if an element was parsed, 0 if more bytes are needed, -1 if the JSON is invalid.
+ */
+static int streamParseElement(JsonStream *stream, cJSON **element)
+{
+    const char *begin = stream->buffer + stream->start;
+    const char *end = NULL;
+
+    arenaBegin(&stream->arena);
+    *element = cJSON_ParseWithLengthOpts(begin, stream->length - stream->start, &end, 0);
+    // Indexed once here: the callbacks only get a const element, and lookups never index it
+    cJSON_IndexObject(*element);
+    arenaEnd();
+
+    // A number at the very end of the window may continue in the next chunk
+    if (*element != NULL && (end < stream->buffer + stream->length || stream->eof))
+    {
+        stream->start = end - stream->buffer;
+        return 1;
+    }
+    arenaReset(&stream->arena);
+    *element = NULL;
+    return stream->eof ? -1 : 0;
+}
+
+/**
+ ** Tells whether a byte is JSON whitespace. A NUL byte is not: it makes the file invalid.
+ * @param c (char) - The byte.
+ * @returns int - 1 for a space, a tab, a carriage return or a line feed, 0 otherwise.
+ */
+static int isJsonSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ ** Reads a JSON file holding an array, one element at a time.
+ * @param path (const char*) - The file.
+ * @param callback (JsonElementCallback) - Called with each element, in order; the element is freed when it returns.
+ *                                         A non-zero return value stops the reading.
+ * @param arg (void*) - Passed to the callback.
+ * @returns long - The number of elements read, or -1 if the file cannot be read or is not a valid array.
+ */
+long jsonStreamArray(const char *path, JsonElementCallback callback, void *arg)
+{
+    JsonStream stream = {.fd = open(path, O_RDONLY)};
+    StreamState state = STREAM_BEFORE_ARRAY;
+    long count = 0;
+    int stop = 0;
+
+    if (stream.fd == -1)
+    {
+        perror("Erreur ouverture JSON");
+        return -1;
+    }
+    arenaInit(&stream.arena);
+
+    while (1)
+    {
+        while (stream.start < stream.length && isJsonSpace(stream.buffer[stream.start]))
+            stream.start++;
+
+        if (stream.start == stream.length)
+        {
+            if (stream.eof)
+                break;
+            if (streamFill(&stream) != 0)
+            {
+                count = -1;
+                break;
+            }
+            continue;
+        }
+
+        char c = stream.buffer[stream.start];
+
+        if (state == STREAM_BEFORE_ARRAY && c == '[')
+        {
+            state = STREAM_FIRST_ELEMENT;
+            stream.start++;
+        }
+        else if ((state == STREAM_FIRST_ELEMENT || state == STREAM_AFTER_ELEMENT) && c == ']')
+        {
+            state = STREAM_DONE;
+            stream.start++;
+        }
+        else if (state == STREAM_AFTER_ELEMENT && c == ',')
+        {
+            state = STREAM_ELEMENT;
+            stream.start++;
+        }
+        // cJSON skips every control character before a value: a NUL byte must not reach it
+        else if ((state == STREAM_FIRST_ELEMENT || state == STREAM_ELEMENT) && c != '\0')
+        {
+            cJSON *element;
+            int parsed = streamParseElement(&stream, &element);
+
+            if (parsed == 0 && streamFill(&stream) == 0)
+                continue;
+            if (parsed <= 0)
+            {
+                count = -1;
+                break;
+            }
+
+            stop = callback(element, arg);
+            // The element and its strings go at once; the block is reused for the next one
+            arenaReset(&stream.arena);
+            count++;
+            state = STREAM_AFTER_ELEMENT;
+            if (stop)
+                break;
+        }
+        else
+        {
+            // Anything but whitespace after the array, or a misplaced character
+            count = -1;
+            break;
+        }
+    }
+
+    if (count >= 0 && !stop && state != STREAM_DONE)
+        count = -1;
+    if (count == -1)
+        fprintf(stderr, "Erreur parsing JSON: %s\n", path);
+    arenaFree(&stream.arena);
+    free(stream.buffer);
+    close(stream.fd);
+    return count;
+}
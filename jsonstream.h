@@ -0,0 +1,21 @@
+#ifndef JSONSTREAM_H
+#define JSONSTREAM_H
+
+#include "cJSON.h"
+
+#define JSON_STREAM_CHUNK (64 * 1024)
+#define JSON_STREAM_MAX_ELEMENT (1024 * 1024)
+
+/*
+ * Lecture en flux d'un fichier JSON contenant un tableau: le fichier est lu par blocs de
+ * JSON_STREAM_CHUNK octets et chaque élément est analysé seul par cJSON dans une arène (arena.h),
+ * puis passé à un callback et libéré d'un coup avec l'arène. L'arbre du tableau complet n'est
+ * jamais construit: la mémoire utilisée ne dépend que de la taille du plus grand élément (au plus
+ * JSON_STREAM_MAX_ELEMENT).
+ */
+
+typedef int (*JsonElementCallback)(const cJSON *element, void *arg);
+
+long jsonStreamArray(const char *path, JsonElementCallback callback, void *arg);
+
+#endif
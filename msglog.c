@@ -0,0 +1,958 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "msglog.h"
+#include "config.h"
+#include "stats.h"
+
+// Tampons d'un message en attente: préfixe et texte, comme pour la diffusion
+#define MSGLOG_MAX_PARTS 2
+
+// Message en attente d'écriture; ses tampons sont ceux de la diffusion, retenus jusqu'à l'écriture
+typedef struct msglog_pending
+{
+    MsgLogHeader header;
+    MessageBuffer *parts[MSGLOG_MAX_PARTS];
+    int part_count;
+    struct msglog_pending *next;
+} MsgLogPending;
+
+// Segment du journal. size et index_count ne comptent que ce qui est durable: un lecteur s'y arrête
+typedef struct msglog_segment
+{
+    uint64_t first_sequence;
+    int64_t first_timestamp;
+    size_t size;
+    size_t index_count;
+} MsgLogSegment;
+
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_ready = PTHREAD_COND_INITIALIZER;
+static MsgLogPending *pending_head = NULL;
+static MsgLogPending *pending_tail = NULL;
+static int64_t last_timestamp = 0;
+static bool stopping = false;
+
+static pthread_mutex_t segments_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MsgLogSegment *segments = NULL;
+static size_t segment_count = 0;
+static size_t segment_capacity = 0;
+
+// Owned by the commit thread once the log is open; a number is given only to a record written
+static uint64_t next_sequence = 1;
+static int log_fd = -1;
+static int index_fd = -1;
+static size_t active_size = 0;
+static size_t next_index_offset = 0;
+
+static atomic_bool enabled = false;
+static pthread_t commit_thread;
+static char directory_path[256];
+static uint32_t crc_table[256];
+
+/**
+ ** Fills the CRC-32 lookup table.
+ * @returns void
+ */
+static void initCrcTable(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        crc_table[i] = crc;
+    }
+}
+
+/**
+ ** Computes the checksum of a record: CRC-32 of everything after the checksum field, message included.
+ * @param header (const MsgLogHeader*) - The record, its message right after the header.
+ * @returns uint32_t - The checksum.
+ */
+static uint32_t recordChecksum(const MsgLogHeader *header)
+{
+    const unsigned char *bytes = (const unsigned char *)header + sizeof(header->checksum);
+    size_t length = sizeof(MsgLogHeader) - sizeof(header->checksum) + header->length;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < length; i++)
+        crc = (crc >> 8) ^ crc_table[(crc ^ bytes[i]) & 0xFF];
+    return ~crc;
+}
+
+/**
+ ** Returns the size of a record in a segment: header, message, and padding to 8 bytes.
+ * @param length (size_t) - The length of the message.
+ * @returns size_t - The size of the record.
+ */
+static size_t recordSize(size_t length)
+{
+    return (sizeof(MsgLogHeader) + length + 7) & ~(size_t)7;
+}
+
+/**
+ ** Returns the current time in milliseconds since the epoch.
+ * @returns int64_t - The time.
+ */
+static int64_t nowMilliseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ ** Builds the path of a segment file.
+ * @param path (char*) - Receives the path.
+ * @param size (size_t) - The size of path.
+ * @param first_sequence (uint64_t) - The first message number of the segment.
+ * @param extension (const char*) - "log" or "idx".
+ * @returns void
+ */
+static void segmentPath(char *path, size_t size, uint64_t first_sequence, const char *extension)
+{
+    snprintf(path, size, "%s/%020llu.%s", directory_path, (unsigned long long)first_sequence, extension);
+}
+
+/**
+ ** Makes a file creation or removal in the log directory durable.
+ * @returns void
+ */
+static void syncDirectory(void)
+{
+    int fd = open(directory_path, O_RDONLY | O_DIRECTORY);
+
+    if (fd != -1)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ ** Writes a whole buffer, resuming after partial writes.
+ * @param fd (int) - The file.
+ * @param data (const void*) - The bytes.
+ * @param length (size_t) - Their number.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int writeAll(int fd, const void *data, size_t length)
+{
+    const char *bytes = data;
+
+    while (length > 0)
+    {
+        ssize_t written = write(fd, bytes, length);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return -1;
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ ** Adds a segment at the end of the segment list.
+ * @param segment (const MsgLogSegment*) - The segment.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+static int addSegment(const MsgLogSegment *segment)
+{
+    pthread_mutex_lock(&segments_mutex);
+    if (segment_count == segment_capacity)
+    {
+        size_t capacity = segment_capacity == 0 ? 16 : segment_capacity * 2;
+        MsgLogSegment *grown = realloc(segments, capacity * sizeof(MsgLogSegment));
+
+        if (grown == NULL)
+        {
+            pthread_mutex_unlock(&segments_mutex);
+            return -1;
+        }
+        segments = grown;
+        segment_capacity = capacity;
+    }
+    segments[segment_count++] = *segment;
+    pthread_mutex_unlock(&segments_mutex);
+
+    atomic_fetch_add(&server_stats.msglog_segments, 1);
+    atomic_fetch_add(&server_stats.msglog_bytes, (long)segment->size);
+    return 0;
+}
+
+/**
+ ** Opens the files of a segment for appending, creating them if needed.
+ * @param first_sequence (uint64_t) - The first message number of the segment.
+ * @param log (int*) - Receives the log descriptor.
+ * @param index (int*) - Receives the index descriptor.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int openSegmentFiles(uint64_t first_sequence, int *log, int *index)
+{
+    char path[320];
+
+    segmentPath(path, sizeof(path), first_sequence, "log");
+    *log = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    segmentPath(path, sizeof(path), first_sequence, "idx");
+    *index = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+
+    if (*log == -1 || *index == -1)
+    {
+        perror("open journal des messages");
+        if (*log != -1)
+            close(*log);
+        if (*index != -1)
+            close(*index);
+        return -1;
+    }
+    syncDirectory();
+    return 0;
+}
+
+/**
+ ** Removes the oldest segments beyond the retention limits: total size, and age of their newest message.
+ * The active segment is never removed. Readers that mapped a removed segment keep reading it.
+ * @returns void
+ */
+static void applyRetention(void)
+{
+    int64_t cutoff = server_config.msglog_retention_hours > 0
+                         ? nowMilliseconds() - (int64_t)server_config.msglog_retention_hours * 3600 * 1000
+                         : INT64_MIN;
+    size_t total = 0;
+    size_t removed = 0;
+    size_t removed_bytes = 0;
+
+    pthread_mutex_lock(&segments_mutex);
+    for (size_t i = 0; i < segment_count; i++)
+        total += segments[i].size;
+
+    // A segment ends where the next one starts: it is too old once the next one started before the cutoff
+    while (segment_count - removed > 1)
+    {
+        MsgLogSegment *next = &segments[removed + 1];
+
+        if (total <= server_config.msglog_retention_bytes && (next->size == 0 || next->first_timestamp >= cutoff))
+            break;
+        total -= segments[removed].size;
+        removed_bytes += segments[removed].size;
+        removed++;
+    }
+
+    uint64_t *victims = removed > 0 ? malloc(removed * sizeof(uint64_t)) : NULL;
+
+    if (victims == NULL)
+        removed = 0;
+    for (size_t i = 0; i < removed; i++)
+        victims[i] = segments[i].first_sequence;
+    memmove(segments, segments + removed, (segment_count - removed) * sizeof(MsgLogSegment));
+    segment_count -= removed;
+    pthread_mutex_unlock(&segments_mutex);
+
+    if (removed == 0)
+        return;
+
+    char path[320];
+
+    for (size_t i = 0; i < removed; i++)
+    {
+        segmentPath(path, sizeof(path), victims[i], "log");
+        unlink(path);
+        segmentPath(path, sizeof(path), victims[i], "idx");
+        unlink(path);
+    }
+    syncDirectory();
+    free(victims);
+
+    atomic_fetch_sub(&server_stats.msglog_segments, (long)removed);
+    atomic_fetch_sub(&server_stats.msglog_bytes, (long)removed_bytes);
+}
+
+/**
+ ** Seals the active segment and starts a new one, then applies the retention limits.
+ * Called by the commit thread; on error, writing goes on in the current segment.
+ * @param first_sequence (uint64_t) - The number of the first message of the new segment.
+ * @returns void
+ */
+static void rollSegment(uint64_t first_sequence)
+{
+    int log;
+    int index;
+
+    if (openSegmentFiles(first_sequence, &log, &index) != 0)
+        return;
+
+    MsgLogSegment segment = {first_sequence, 0, 0, 0};
+
+    if (addSegment(&segment) != 0)
+    {
+        close(log);
+        close(index);
+        return;
+    }
+
+    // The log data is already durable; the index of a sealed segment is never rebuilt
+    fdatasync(index_fd);
+    close(log_fd);
+    close(index_fd);
+    log_fd = log;
+    index_fd = index;
+    active_size = 0;
+    next_index_offset = 0;
+
+    applyRetention();
+}
+
+/**
+ ** Writes a batch of records to the active segment with one write and one fdatasync, then its
+ * index entries, and makes them visible to the readers. If the records do not reach the disk, they
+ * are counted as lost and their numbers are given again to the next ones.
+ * @param buffer (const char*) - The records, numbered from next_sequence - record_count.
+ * @param length (size_t) - Their size.
+ * @param entries (const MsgLogIndexEntry*) - The index entries of the records.
+ * @param entry_count (size_t) - Their number.
+ * @param record_count (size_t) - The number of records.
+ * @returns void
+ */
+static void flushRecords(const char *buffer, size_t length, const MsgLogIndexEntry *entries, size_t entry_count,
+                         size_t record_count)
+{
+    if (length == 0)
+        return;
+
+    if (writeAll(log_fd, buffer, length) != 0 || fdatasync(log_fd) != 0)
+    {
+        perror("écriture journal des messages");
+        // A partial batch would be cut off at the next startup anyway
+        if (ftruncate(log_fd, (off_t)active_size) != 0)
+            perror("ftruncate journal des messages");
+        fprintf(stderr, "Journal des messages: %zu messages perdus\n", record_count);
+        atomic_fetch_add(&server_stats.msglog_dropped, record_count);
+        next_sequence -= record_count;
+        next_index_offset = active_size;
+        return;
+    }
+
+    pthread_mutex_lock(&segments_mutex);
+    MsgLogSegment *segment = &segments[segment_count - 1];
+
+    if (entry_count > 0 && writeAll(index_fd, entries, entry_count * sizeof(MsgLogIndexEntry)) != 0)
+    {
+        // Readers fall back on scanning from the last entry that made it
+        perror("écriture index des messages");
+        if (ftruncate(index_fd, (off_t)(segment->index_count * sizeof(MsgLogIndexEntry))) != 0)
+            perror("ftruncate index des messages");
+        entry_count = 0;
+    }
+    if (segment->size == 0)
+        segment->first_timestamp = ((const MsgLogHeader *)buffer)->timestamp;
+    segment->index_count += entry_count;
+    active_size += length;
+    segment->size = active_size;
+    pthread_mutex_unlock(&segments_mutex);
+
+    atomic_fetch_add(&server_stats.msglog_records, record_count);
+    atomic_fetch_add(&server_stats.msglog_commits, 1);
+    atomic_fetch_add(&server_stats.msglog_bytes, (long)length);
+}
+
+/**
+ ** Writes a batch of waiting messages, rolling over to a new segment when the active one is full.
+ * The messages are numbered here, so that a batch lost before the disk leaves no hole.
+ * @param batch (MsgLogPending*) - The messages, in order.
+ * @returns void
+ */
+static void writeBatch(MsgLogPending *batch)
+{
+    size_t length = 0;
+    size_t count = 0;
+
+    for (MsgLogPending *current = batch; current != NULL; current = current->next)
+    {
+        length += recordSize(current->header.length);
+        count++;
+    }
+
+    // At most one index entry per record
+    char *buffer = malloc(length);
+    MsgLogIndexEntry *entries = malloc(count * sizeof(MsgLogIndexEntry));
+
+    if (buffer == NULL || entries == NULL)
+    {
+        perror("malloc journal des messages");
+        fprintf(stderr, "Journal des messages: %zu messages perdus\n", count);
+        atomic_fetch_add(&server_stats.msglog_dropped, count);
+        free(buffer);
+        free(entries);
+        return;
+    }
+
+    size_t used = 0;
+    size_t entry_count = 0;
+    size_t record_count = 0;
+
+    for (MsgLogPending *current = batch; current != NULL; current = current->next)
+    {
+        size_t size = recordSize(current->header.length);
+
+        if (active_size + used > 0 && active_size + used + size > server_config.msglog_segment_size)
+        {
+            flushRecords(buffer, used, entries, entry_count, record_count);
+            rollSegment(next_sequence);
+            used = entry_count = record_count = 0;
+        }
+
+        size_t offset = active_size + used;
+        MsgLogHeader *header = (MsgLogHeader *)(buffer + used);
+        char *data = buffer + used + sizeof(MsgLogHeader);
+
+        *header = current->header;
+        header->sequence = next_sequence++;
+        if (offset >= next_index_offset)
+        {
+            entries[entry_count].sequence = header->sequence;
+            entries[entry_count].timestamp = header->timestamp;
+            entries[entry_count].offset = offset;
+            entry_count++;
+            next_index_offset = offset + MSGLOG_INDEX_INTERVAL;
+        }
+        for (int i = 0; i < current->part_count; i++)
+        {
+            memcpy(data, current->parts[i]->data, current->parts[i]->length);
+            data += current->parts[i]->length;
+        }
+        memset(data, 0, buffer + used + size - data);
+        header->checksum = recordChecksum(header);
+        used += size;
+        record_count++;
+    }
+    flushRecords(buffer, used, entries, entry_count, record_count);
+    free(buffer);
+    free(entries);
+}
+
+/**
+ ** Writes the waiting messages in batches until the log is closed and nothing is left.
+ * @param arg (void*) - Unused.
+ * @returns void*
+ */
+static void *commitThread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&pending_mutex);
+        while (pending_head == NULL && !stopping)
+            pthread_cond_wait(&pending_ready, &pending_mutex);
+
+        MsgLogPending *batch = pending_head;
+        pending_head = pending_tail = NULL;
+        pthread_mutex_unlock(&pending_mutex);
+
+        if (batch == NULL)
+            break;
+        writeBatch(batch);
+
+        while (batch != NULL)
+        {
+            MsgLogPending *next = batch->next;
+
+            for (int i = 0; i < batch->part_count; i++)
+                bufferRelease(batch->parts[i]);
+            free(batch);
+            batch = next;
+        }
+    }
+    return NULL;
+}
+
+/**
+ ** Checks the last segment after a restart: cuts off its torn tail, rebuilds its index, and finds
+ * the number of the next message. Only a bad length or checksum, or a number that does not
+ * increase, marks the tail.
+ * @param segment (MsgLogSegment*) - The last segment; its size and index count are updated.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int recoverSegment(MsgLogSegment *segment)
+{
+    char path[320];
+
+    segmentPath(path, sizeof(path), segment->first_sequence, "log");
+
+    // A new log has no segment yet: its first one is created here
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+
+    if (fd == -1)
+    {
+        perror("open journal des messages");
+        return -1;
+    }
+
+    size_t size = segment->size;
+    char *base = size > 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+
+    if (base == MAP_FAILED)
+    {
+        perror("mmap journal des messages");
+        close(fd);
+        return -1;
+    }
+
+    MsgLogIndexEntry *entries = malloc((size / MSGLOG_INDEX_INTERVAL + 1) * sizeof(MsgLogIndexEntry));
+    size_t entry_count = 0;
+    size_t offset = 0;
+    uint64_t sequence = segment->first_sequence;
+
+    next_index_offset = 0;
+    while (entries != NULL && size - offset >= sizeof(MsgLogHeader))
+    {
+        const MsgLogHeader *header = (const MsgLogHeader *)(base + offset);
+
+        if (header->length > size - offset - sizeof(MsgLogHeader) || recordSize(header->length) > size - offset ||
+            header->sequence < sequence || header->checksum != recordChecksum(header))
+            break;
+
+        if (offset >= next_index_offset)
+        {
+            entries[entry_count].sequence = header->sequence;
+            entries[entry_count].timestamp = header->timestamp;
+            entries[entry_count].offset = offset;
+            entry_count++;
+            next_index_offset = offset + MSGLOG_INDEX_INTERVAL;
+        }
+        if (offset == 0)
+            segment->first_timestamp = header->timestamp;
+        last_timestamp = header->timestamp;
+        sequence = header->sequence + 1;
+        offset += recordSize(header->length);
+    }
+    if (base != NULL)
+        munmap(base, size);
+
+    // The end of the last batch may not have reached the disk before a crash
+    if (offset != size)
+    {
+        fprintf(stderr, "Journal des messages %s: %zu octets invalides ignorés\n", path, size - offset);
+        if (ftruncate(fd, (off_t)offset) != 0 || fdatasync(fd) != 0)
+            perror("ftruncate journal des messages");
+    }
+    close(fd);
+
+    segmentPath(path, sizeof(path), segment->first_sequence, "idx");
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1 || entries == NULL || writeAll(fd, entries, entry_count * sizeof(MsgLogIndexEntry)) != 0)
+    {
+        perror("index des messages");
+        entry_count = 0;
+    }
+    if (fd != -1)
+        close(fd);
+    free(entries);
+
+    segment->size = offset;
+    segment->index_count = entry_count;
+    next_sequence = sequence;
+    active_size = offset;
+    return 0;
+}
+
+/**
+ ** Compares two segment numbers, for qsort.
+ * @param a (const void*) - The first uint64_t.
+ * @param b (const void*) - The second uint64_t.
+ * @returns int - Negative, zero or positive.
+ */
+static int compareSequences(const void *a, const void *b)
+{
+    uint64_t left = *(const uint64_t *)a;
+    uint64_t right = *(const uint64_t *)b;
+
+    return (left > right) - (left < right);
+}
+
+/**
+ ** Lists the segments found in the log directory, in order.
+ * @param count (size_t*) - Receives their number.
+ * @returns uint64_t* - Their first message numbers, to free; NULL if there are none or on error.
+ */
+static uint64_t *listSegments(size_t *count)
+{
+    DIR *directory = opendir(directory_path);
+    uint64_t *sequences = NULL;
+    size_t capacity = 0;
+    struct dirent *file;
+
+    *count = 0;
+    if (directory == NULL)
+    {
+        perror("opendir journal des messages");
+        return NULL;
+    }
+
+    while ((file = readdir(directory)) != NULL)
+    {
+        unsigned long long sequence;
+        char extension[8];
+
+        if (strlen(file->d_name) != 24 || sscanf(file->d_name, "%20llu.%3s", &sequence, extension) != 2 ||
+            strcmp(extension, "log") != 0)
+            continue;
+
+        if (*count == capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            uint64_t *grown = realloc(sequences, capacity * sizeof(uint64_t));
+
+            if (grown == NULL)
+                break;
+            sequences = grown;
+        }
+        sequences[(*count)++] = sequence;
+    }
+    closedir(directory);
+
+    if (sequences != NULL)
+        qsort(sequences, *count, sizeof(uint64_t), compareSequences);
+    return sequences;
+}
+
+/**
+ ** Opens the message log: finds its segments, recovers the last one, applies the retention limits
+ * and starts the commit thread.
+ * @param directory (const char*) - The directory of the segments, created if needed.
+ * @returns int - 0 on success, -1 on error.
+ */
+int msglogOpen(const char *directory)
+{
+    snprintf(directory_path, sizeof(directory_path), "%s", directory);
+    initCrcTable();
+
+    if (mkdir(directory_path, 0700) != 0 && errno != EEXIST)
+    {
+        perror("mkdir journal des messages");
+        return -1;
+    }
+
+    size_t count;
+    uint64_t *sequences = listSegments(&count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        MsgLogSegment segment = {sequences[i], 0, 0, 0};
+        char path[320];
+        struct stat st;
+        MsgLogHeader header;
+
+        segmentPath(path, sizeof(path), segment.first_sequence, "log");
+
+        int fd = open(path, O_RDONLY);
+
+        if (fd != -1 && fstat(fd, &st) == 0)
+        {
+            segment.size = (size_t)st.st_size;
+            if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header))
+                segment.first_timestamp = header.timestamp;
+        }
+        if (fd != -1)
+            close(fd);
+
+        segmentPath(path, sizeof(path), segment.first_sequence, "idx");
+        if (stat(path, &st) == 0)
+            segment.index_count = (size_t)st.st_size / sizeof(MsgLogIndexEntry);
+
+        if (addSegment(&segment) != 0)
+        {
+            free(sequences);
+            return -1;
+        }
+    }
+    free(sequences);
+
+    if (segment_count == 0)
+    {
+        MsgLogSegment segment = {1, 0, 0, 0};
+
+        if (addSegment(&segment) != 0)
+            return -1;
+    }
+
+    MsgLogSegment *last = &segments[segment_count - 1];
+    size_t previous_size = last->size;
+
+    if (recoverSegment(last) != 0 || openSegmentFiles(last->first_sequence, &log_fd, &index_fd) != 0)
+        return -1;
+    atomic_fetch_sub(&server_stats.msglog_bytes, (long)(previous_size - last->size));
+    applyRetention();
+    printf("Journal des messages: %zu segment(s), prochain message %llu\n", segment_count,
+           (unsigned long long)next_sequence);
+
+    if (pthread_create(&commit_thread, NULL, commitThread, NULL) != 0)
+    {
+        perror("pthread_create journal des messages");
+        return -1;
+    }
+    atomic_store(&enabled, true);
+    return 0;
+}
+
+/**
+ ** Writes the messages still waiting, stops the commit thread and closes the active segment.
+ * @returns void
+ */
+void msglogClose(void)
+{
+    if (!atomic_exchange(&enabled, false))
+        return;
+
+    pthread_mutex_lock(&pending_mutex);
+    stopping = true;
+    pthread_cond_signal(&pending_ready);
+    pthread_mutex_unlock(&pending_mutex);
+
+    pthread_join(commit_thread, NULL);
+    fdatasync(index_fd);
+    close(log_fd);
+    close(index_fd);
+}
+
+/**
+ ** Tells whether the message log is open.
+ * @returns int - 1 if it is, 0 otherwise.
+ */
+int msglogEnabled(void)
+{
+    return atomic_load(&enabled);
+}
+
+/**
+ ** Queues a channel message for the next batch. Its time is given here, in queue order; its number
+ * only once it is written.
+ * @param channel (const char*) - The name of the channel.
+ * @param parts (MessageBuffer**) - The buffers of the message as sent; only references are taken.
+ * @param part_count (int) - The number of buffers, at most 2.
+ * @returns int - 0 if the message was queued, -1 if the log is closed or memory is exhausted.
+ */
+int msglogAppend(const char *channel, MessageBuffer **parts, int part_count)
+{
+    if (!atomic_load(&enabled) || part_count > MSGLOG_MAX_PARTS)
+        return -1;
+
+    MsgLogPending *pending = calloc(1, sizeof(MsgLogPending));
+
+    if (pending == NULL)
+        return -1;
+
+    // The header is zeroed first: the checksum covers its padding bytes too
+    strncpy(pending->header.channel, channel, MSGLOG_CHANNEL_SIZE - 1);
+    for (int i = 0; i < part_count; i++)
+    {
+        pending->parts[i] = bufferRetain(parts[i]);
+        pending->header.length += (uint32_t)parts[i]->length;
+    }
+    pending->part_count = part_count;
+
+    int64_t now = nowMilliseconds();
+
+    pthread_mutex_lock(&pending_mutex);
+    // Times never go backwards in the log, so that they can be searched like the numbers
+    if (now < last_timestamp)
+        now = last_timestamp;
+    last_timestamp = now;
+    pending->header.timestamp = now;
+
+    if (pending_tail != NULL)
+        pending_tail->next = pending;
+    else
+        pending_head = pending;
+    pending_tail = pending;
+    pthread_cond_signal(&pending_ready);
+    pthread_mutex_unlock(&pending_mutex);
+    return 0;
+}
+
+/**
+ ** Finds where to start reading a segment, from its sparse index: the last indexed record before the target.
+ * @param segment (const MsgLogSegment*) - The segment.
+ * @param by_time (int) - 1 to search a time, 0 a message number.
+ * @param target (int64_t) - The time or the number.
+ * @returns size_t - The offset of the record to start from.
+ */
+static size_t findOffset(const MsgLogSegment *segment, int by_time, int64_t target)
+{
+    char path[320];
+
+    if (segment->index_count == 0)
+        return 0;
+
+    segmentPath(path, sizeof(path), segment->first_sequence, "idx");
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+        return 0;
+
+    size_t length = segment->index_count * sizeof(MsgLogIndexEntry);
+    const MsgLogIndexEntry *entries = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (entries == MAP_FAILED)
+        return 0;
+
+    // Both keys grow along the segment: binary search of the last entry below the target
+    size_t low = 0;
+    size_t high = segment->index_count;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int64_t key = by_time ? entries[middle].timestamp : (int64_t)entries[middle].sequence;
+
+        if (key < target)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    size_t offset = low > 0 ? entries[low - 1].offset : 0;
+
+    munmap((void *)entries, length);
+    return offset < segment->size ? offset : 0;
+}
+
+/**
+ ** Visits the messages of a segment from a number or a time, through a read-only mapping of its durable part.
+ * @param segment (const MsgLogSegment*) - The segment, as copied from the list.
+ * @param by_time (int) - 1 to start from a time, 0 from a message number.
+ * @param target (int64_t) - The time or the number.
+ * @param visit (MsgLogVisit) - Called for each message.
+ * @param arg (void*) - Passed to visit.
+ * @returns int - 1 if visit stopped the reading, 0 otherwise.
+ */
+static int readSegment(const MsgLogSegment *segment, int by_time, int64_t target, MsgLogVisit visit, void *arg)
+{
+    char path[320];
+
+    if (segment->size == 0)
+        return 0;
+
+    segmentPath(path, sizeof(path), segment->first_sequence, "log");
+
+    // The segment may have been removed by the retention since the list was copied
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+        return 0;
+
+    const char *base = mmap(NULL, segment->size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+
+    int stopped = 0;
+    size_t offset = findOffset(segment, by_time, target);
+
+    while (!stopped && segment->size - offset >= sizeof(MsgLogHeader))
+    {
+        const MsgLogHeader *header = (const MsgLogHeader *)(base + offset);
+
+        if (header->length > segment->size - offset - sizeof(MsgLogHeader) || header->checksum != recordChecksum(header))
+            break;
+
+        if ((by_time ? header->timestamp : (int64_t)header->sequence) >= target)
+        {
+            MsgLogEntry entry = {header->sequence, header->timestamp, header->channel,
+                                 (const char *)(header + 1), header->length};
+
+            stopped = visit(&entry, arg) != 0;
+        }
+        offset += recordSize(header->length);
+    }
+    munmap((void *)base, segment->size);
+    return stopped;
+}
+
+/**
+ ** Visits the messages of the log from a number or a time, oldest first.
+ * The segment list is copied under its lock; the segments are then read without any lock.
+ * @param by_time (int) - 1 to start from a time in milliseconds, 0 from a message number.
+ * @param target (int64_t) - The time or the number.
+ * @param visit (MsgLogVisit) - Called for each message; returns non-zero to stop.
+ * @param arg (void*) - Passed to visit.
+ * @returns int - 0 on success, -1 if the log is closed or memory is exhausted.
+ */
+static int readFrom(int by_time, int64_t target, MsgLogVisit visit, void *arg)
+{
+    if (!atomic_load(&enabled))
+        return -1;
+
+    pthread_mutex_lock(&segments_mutex);
+    size_t count = segment_count;
+    MsgLogSegment *copy = malloc(count * sizeof(MsgLogSegment));
+
+    if (copy != NULL)
+        memcpy(copy, segments, count * sizeof(MsgLogSegment));
+    pthread_mutex_unlock(&segments_mutex);
+
+    if (copy == NULL)
+        return -1;
+
+    // The last segment starting before the target holds its first message, or the target is older than the log
+    size_t start = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (by_time ? copy[i].size > 0 && copy[i].first_timestamp < target : (int64_t)copy[i].first_sequence <= target)
+            start = i;
+    }
+
+    for (size_t i = start; i < count; i++)
+    {
+        if (readSegment(&copy[i], by_time, target, visit, arg))
+            break;
+    }
+    free(copy);
+    return 0;
+}
+
+/**
+ ** Visits the messages of the log from a message number, oldest first.
+ * @param sequence (uint64_t) - The number of the first message wanted.
+ * @param visit (MsgLogVisit) - Called for each message; returns non-zero to stop.
+ * @param arg (void*) - Passed to visit.
+ * @returns int - 0 on success, -1 if the log is closed or memory is exhausted.
+ */
+int msglogReadFromSequence(uint64_t sequence, MsgLogVisit visit, void *arg)
+{
+    if (sequence > INT64_MAX)
+        sequence = INT64_MAX;
+    return readFrom(0, (int64_t)sequence, visit, arg);
+}
+
+/**
+ ** Visits the messages of the log sent at or after a time, oldest first.
+ * @param since (time_t) - The time, in seconds since the epoch.
+ * @param visit (MsgLogVisit) - Called for each message; returns non-zero to stop.
+ * @param arg (void*) - Passed to visit.
+ * @returns int - 0 on success, -1 if the log is closed or memory is exhausted.
+ */
+int msglogReadFromTime(time_t since, MsgLogVisit visit, void *arg)
+{
+    return readFrom(1, (int64_t)since * 1000, visit, arg);
+}
@@ -0,0 +1,63 @@
+#ifndef MSGLOG_H
+#define MSGLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "buffer.h"
+
+#define MSGLOG_CHANNEL_SIZE 32
+// Octets de segment entre deux entrées de l'index clairsemé
+#define MSGLOG_INDEX_INTERVAL 4096
+
+// En-tête d'un enregistrement, suivi du message tel qu'envoyé puis de remplissage jusqu'à un
+// multiple de 8 octets. checksum couvre tout ce qui le suit, message compris.
+typedef struct msglog_header
+{
+    uint32_t checksum;
+    uint32_t length;
+    uint64_t sequence;
+    int64_t timestamp;
+    char channel[MSGLOG_CHANNEL_SIZE];
+} MsgLogHeader;
+
+// Entrée de l'index d'un segment: position du premier enregistrement d'un bloc
+typedef struct msglog_index_entry
+{
+    uint64_t sequence;
+    int64_t timestamp;
+    uint64_t offset;
+} MsgLogIndexEntry;
+
+// Message lu dans le journal; channel et data pointent dans le segment projeté, valides pendant la visite
+typedef struct msglog_entry
+{
+    uint64_t sequence;
+    int64_t timestamp;
+    const char *channel;
+    const char *data;
+    size_t length;
+} MsgLogEntry;
+
+/*
+ * Journal durable des messages des salons, en segments <répertoire>/<premier numéro>.log.
+ * Chaque segment a son index clairsemé (<premier numéro>.idx): une entrée par bloc de
+ * MSGLOG_INDEX_INTERVAL octets, pour trouver un numéro ou une date sans tout parcourir.
+ * Un thread d'écriture regroupe les messages en attente: une écriture et un fdatasync par lot.
+ * Un segment plein est scellé et un nouveau commence; les plus anciens sont supprimés au-delà
+ * de la rétention configurée (octets et âge). Les lecteurs projettent les segments avec mmap,
+ * jusqu'à la taille déjà durable: ils ne prennent un verrou que pour copier la liste des segments.
+ * Au démarrage, la fin déchirée du dernier segment est coupée et son index reconstruit.
+ */
+
+// Visite d'un message lu; un retour non nul arrête la lecture
+typedef int (*MsgLogVisit)(const MsgLogEntry *entry, void *arg);
+
+int msglogOpen(const char *directory);
+void msglogClose(void);
+int msglogEnabled(void);
+int msglogAppend(const char *channel, MessageBuffer **parts, int part_count);
+int msglogReadFromSequence(uint64_t sequence, MsgLogVisit visit, void *arg);
+int msglogReadFromTime(time_t since, MsgLogVisit visit, void *arg);
+
+#endif
@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "protocol.h"
+
+#define DECODER_INITIAL_CAPACITY 4096
+
+/**
+ ** Writes a v2 frame header.
+ * @param header (unsigned char*) - Destination, FRAME_HEADER_SIZE bytes.
+ * @param type (FrameType) - The frame type.
+ * @param length (uint32_t) - The payload length.
+ * @returns void
+ */
+void frameEncodeHeader(unsigned char *header, FrameType type, uint32_t length)
+{
+    header[0] = FRAME_MAGIC;
+    header[1] = (unsigned char)type;
+    header[2] = 0;
+    header[3] = 0;
+    header[4] = (unsigned char)(length >> 24);
+    header[5] = (unsigned char)(length >> 16);
+    header[6] = (unsigned char)(length >> 8);
+    header[7] = (unsigned char)length;
+}
+
+/**
+ ** Initializes an empty decoder. Its buffer is allocated on first use.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @returns void
+ */
+void frameDecoderInit(FrameDecoder *decoder)
+{
+    decoder->buffer = NULL;
+    decoder->capacity = 0;
+    decoder->start = 0;
+    decoder->end = 0;
+    decoder->terminator = 0;
+    decoder->saved = 0;
+}
+
+/**
+ ** Releases the buffer of a decoder.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @returns void
+ */
+void frameDecoderFree(FrameDecoder *decoder)
+{
+    free(decoder->buffer);
+    frameDecoderInit(decoder);
+}
+
+/**
+ ** Puts back the byte overwritten by the '\0' of the last returned frame.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @returns void
+ */
+static void restoreTerminator(FrameDecoder *decoder)
+{
+    if (decoder->terminator > 0)
+    {
+        decoder->buffer[decoder->terminator - 1] = decoder->saved;
+        decoder->terminator = 0;
+    }
+}
+
+/**
+ ** Returns free space at the end of the decoder, to receive data into directly.
+ * Invalidates the payload of previously returned frames.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @param wanted (size_t) - The minimum free space wanted.
+ * @param available (size_t*) - Receives the free space actually available.
+ * @returns char* - Where to write, or NULL if out of memory.
+ */
+char *frameDecoderSpace(FrameDecoder *decoder, size_t wanted, size_t *available)
+{
+    restoreTerminator(decoder);
+
+    if (decoder->start == decoder->end)
+    {
+        decoder->start = 0;
+        decoder->end = 0;
+    }
+    else if (decoder->start > 0 && decoder->capacity - decoder->end < wanted)
+    {
+        memmove(decoder->buffer, decoder->buffer + decoder->start, decoder->end - decoder->start);
+        decoder->end -= decoder->start;
+        decoder->start = 0;
+    }
+
+    // One spare byte is always kept to '\0'-terminate a payload that ends the buffer
+    if (decoder->capacity == 0 || decoder->capacity - decoder->end < wanted + 1)
+    {
+        size_t capacity = decoder->capacity == 0 ? DECODER_INITIAL_CAPACITY : decoder->capacity;
+
+        while (capacity - decoder->end < wanted + 1)
+        {
+            capacity *= 2;
+        }
+        char *buffer = realloc(decoder->buffer, capacity);
+
+        if (buffer == NULL)
+            return NULL;
+
+        decoder->buffer = buffer;
+        decoder->capacity = capacity;
+    }
+    *available = decoder->capacity - decoder->end - 1;
+    return decoder->buffer + decoder->end;
+}
+
+/**
+ ** Records that bytes were written into the space returned by frameDecoderSpace.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @param length (size_t) - The number of bytes received.
+ * @returns void
+ */
+void frameDecoderCommit(FrameDecoder *decoder, size_t length)
+{
+    decoder->end += length;
+}
+
+/**
+ ** Reads the length of the frame at the start of the decoder.
+ * @param decoder (const FrameDecoder*) - The decoder.
+ * @returns uint32_t - The payload length.
+ */
+static uint32_t headerLength(const FrameDecoder *decoder)
+{
+    const unsigned char *header = (const unsigned char *)decoder->buffer + decoder->start;
+
+    return ((uint32_t)header[4] << 24) | ((uint32_t)header[5] << 16) | ((uint32_t)header[6] << 8) | header[7];
+}
+
+/**
+ ** Tells whether a complete frame is waiting in the decoder.
+ * @param decoder (const FrameDecoder*) - The decoder.
+ * @returns int - 1 if frameDecoderNext would return a frame or an error, 0 otherwise.
+ */
+int frameDecoderHasFrame(const FrameDecoder *decoder)
+{
+    size_t pending = decoder->end - decoder->start;
+
+    if (pending < FRAME_HEADER_SIZE)
+        return 0;
+
+    // The first byte may be hidden by the '\0' of the previous payload
+    char first = decoder->terminator == decoder->start + 1 ? decoder->saved : decoder->buffer[decoder->start];
+
+    if ((unsigned char)first != FRAME_MAGIC)
+        return 1;
+    return pending - FRAME_HEADER_SIZE >= headerLength(decoder);
+}
+
+/**
+ ** Extracts the next complete frame. The payload stays in the decoder buffer and is '\0'-terminated;
+ * it remains valid until the next call on the decoder.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @param frame (Frame*) - Receives the frame.
+ * @returns int - 1 if a frame was extracted, 0 if more data is needed, -1 on a protocol error.
+ */
+int frameDecoderNext(FrameDecoder *decoder, Frame *frame)
+{
+    restoreTerminator(decoder);
+
+    if (decoder->end - decoder->start < FRAME_HEADER_SIZE)
+        return 0;
+
+    const unsigned char *header = (const unsigned char *)decoder->buffer + decoder->start;
+    uint32_t length = headerLength(decoder);
+
+    if (header[0] != FRAME_MAGIC || length > FRAME_MAX_PAYLOAD)
+        return -1;
+    if (decoder->end - decoder->start - FRAME_HEADER_SIZE < length)
+        return 0;
+
+    frame->type = (FrameType)header[1];
+    frame->payload = decoder->buffer + decoder->start + FRAME_HEADER_SIZE;
+    frame->length = length;
+
+    decoder->start += FRAME_HEADER_SIZE + length;
+    decoder->terminator = decoder->start + 1;
+    decoder->saved = decoder->buffer[decoder->start];
+    decoder->buffer[decoder->start] = '\0';
+    return 1;
+}
+
+/**
+ ** Returns the number of received bytes not consumed yet.
+ * @param decoder (const FrameDecoder*) - The decoder.
+ * @returns size_t - The number of pending bytes.
+ */
+size_t frameDecoderPending(const FrameDecoder *decoder)
+{
+    return decoder->end - decoder->start;
+}
+
+/**
+ ** Copies out pending bytes that are not frames, such as the raw content of a file transfer.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @param destination (void*) - Where to copy.
+ * @param length (size_t) - The maximum number of bytes.
+ * @returns size_t - The number of bytes copied.
+ */
+size_t frameDecoderTake(FrameDecoder *decoder, void *destination, size_t length)
+{
+    restoreTerminator(decoder);
+
+    size_t pending = decoder->end - decoder->start;
+
+    if (length > pending)
+        length = pending;
+
+    memcpy(destination, decoder->buffer + decoder->start, length);
+    decoder->start += length;
+    return length;
+}
+
+/**
+ ** Drops the pending bytes that precede the first frame header, such as the text prompt
+ * a server sends before it knows the client speaks v2.
+ * @param decoder (FrameDecoder*) - The decoder.
+ * @returns size_t - The number of bytes dropped.
+ */
+size_t frameDecoderResync(FrameDecoder *decoder)
+{
+    restoreTerminator(decoder);
+
+    size_t dropped = 0;
+
+    while (decoder->start < decoder->end && (unsigned char)decoder->buffer[decoder->start] != FRAME_MAGIC)
+    {
+        decoder->start++;
+        dropped++;
+    }
+    return dropped;
+}
+
+/**
+ ** Sends a complete frame on a blocking socket.
+ * @param fd (int) - The socket.
+ * @param type (FrameType) - The frame type.
+ * @param payload (const void*) - The payload.
+ * @param length (uint32_t) - The payload length.
+ * @returns int - 0 on success, -1 on error.
+ */
+int frameSend(int fd, FrameType type, const void *payload, uint32_t length)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    struct iovec iov[2];
+    size_t total = FRAME_HEADER_SIZE + length;
+    size_t sent = 0;
+
+    frameEncodeHeader(header, type, length);
+
+    while (sent < total)
+    {
+        int iovcnt = 0;
+
+        if (sent < FRAME_HEADER_SIZE)
+        {
+            iov[iovcnt].iov_base = header + sent;
+            iov[iovcnt].iov_len = FRAME_HEADER_SIZE - sent;
+            iovcnt++;
+        }
+        size_t payload_sent = sent > FRAME_HEADER_SIZE ? sent - FRAME_HEADER_SIZE : 0;
+
+        if (length > payload_sent)
+        {
+            iov[iovcnt].iov_base = (char *)payload + payload_sent;
+            iov[iovcnt].iov_len = length - payload_sent;
+            iovcnt++;
+        }
+
+        struct msghdr message = {0};
+        message.msg_iov = iov;
+        message.msg_iovlen = iovcnt;
+        ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        sent += (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ ** Reads the next frame from a blocking socket, keeping extra bytes in the decoder.
+ * @param fd (int) - The socket.
+ * @param decoder (FrameDecoder*) - The decoder of this socket.
+ * @param frame (Frame*) - Receives the frame.
+ * @returns int - 1 if a frame was read, 0 if the connection was closed, -1 on error.
+ */
+int frameRead(int fd, FrameDecoder *decoder, Frame *frame)
+{
+    while (1)
+    {
+        int result = frameDecoderNext(decoder, frame);
+
+        if (result != 0)
+            return result;
+
+        size_t available;
+        char *space = frameDecoderSpace(decoder, 4096, &available);
+
+        if (space == NULL)
+            return -1;
+
+        ssize_t received = recv(fd, space, available, 0);
+
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return received == 0 ? 0 : -1;
+
+        frameDecoderCommit(decoder, (size_t)received);
+    }
+}
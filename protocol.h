@@ -0,0 +1,58 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Protocole v2: chaque message est précédé d'un en-tête de 8 octets
+ *   [0] FRAME_MAGIC  [1] type  [2..3] réservé (0)  [4..7] longueur du contenu (big endian)
+ * Le client annonce le protocole en envoyant une trame FRAME_HELLO dès la connexion.
+ * 0xFA ne peut pas commencer un texte UTF-8: un client texte (legacy) n'est jamais pris pour un client v2.
+ */
+#define FRAME_MAGIC 0xFA
+#define FRAME_HEADER_SIZE 8
+#define FRAME_MAX_PAYLOAD (1024 * 1024)
+#define PROTOCOL_VERSION "2"
+
+typedef enum
+{
+    FRAME_HELLO = 1,
+    FRAME_TEXT = 2,
+    FRAME_TRANSFER = 3,
+} FrameType;
+
+typedef struct frame
+{
+    FrameType type;
+    char *payload;
+    uint32_t length;
+} Frame;
+
+// Décodeur incrémental: accumule les octets reçus et découpe les trames complètes
+typedef struct frame_decoder
+{
+    char *buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    size_t terminator;
+    char saved;
+} FrameDecoder;
+
+void frameEncodeHeader(unsigned char *header, FrameType type, uint32_t length);
+
+void frameDecoderInit(FrameDecoder *decoder);
+void frameDecoderFree(FrameDecoder *decoder);
+char *frameDecoderSpace(FrameDecoder *decoder, size_t wanted, size_t *available);
+void frameDecoderCommit(FrameDecoder *decoder, size_t length);
+int frameDecoderNext(FrameDecoder *decoder, Frame *frame);
+int frameDecoderHasFrame(const FrameDecoder *decoder);
+size_t frameDecoderPending(const FrameDecoder *decoder);
+size_t frameDecoderTake(FrameDecoder *decoder, void *destination, size_t length);
+size_t frameDecoderResync(FrameDecoder *decoder);
+
+int frameSend(int fd, FrameType type, const void *payload, uint32_t length);
+int frameRead(int fd, FrameDecoder *decoder, Frame *frame);
+
+#endif
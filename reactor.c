@@ -0,0 +1,840 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "reactor.h"
+#include "config.h"
+#include "stats.h"
+
+#define MAX_EVENTS 256
+
+static Reactor reactors[MAX_REACTORS];
+static int reactor_count = 0;
+static int *shutdown_flag = NULL;
+static _Atomic(Connection *) *connections = NULL;
+static _Atomic(Reactor *) *owners = NULL;
+static int connections_capacity = 0;
+
+/**
+ ** Raises the open file limit to its hard maximum so that the reactor can hold many idle sockets.
+ * Tables indexed by file descriptor are sized with its result.
+ * @returns int - The number of file descriptors the process may open.
+ */
+int reactorRaiseFileLimit(void)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return 1024;
+
+    if (limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+            getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > 1 << 20)
+        return 1 << 20;
+    return (int)limit.rlim_cur;
+}
+
+/**
+ ** Opens a listening socket on the server port. SO_REUSEPORT lets every reactor bind its own
+ * listener so that the kernel spreads incoming connections between them.
+ * @returns int - The non-blocking listening socket, or -1 on error.
+ */
+static int createListener(void)
+{
+    int listen_fd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listen_fd == -1)
+    {
+        perror("socket");
+        return -1;
+    }
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt");
+        close(listen_fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons((short)SERVER_PORT);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        perror("bind");
+        close(listen_fd);
+        return -1;
+    }
+    if (listen(listen_fd, SOMAXCONN) == -1)
+    {
+        perror("listen");
+        close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
+
+/**
+ ** Creates the epoll instance, the listener and the connection shard of a reactor.
+ * @param reactor (Reactor*) - The reactor to initialize.
+ * @param id (int) - The reactor index.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int reactorInit(Reactor *reactor, int id)
+{
+    reactor->id = id;
+    reactor->cpu = -1;
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (reactor->epoll_fd == -1)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    reactor->listen_fd = createListener();
+
+    if (reactor->listen_fd == -1)
+        return -1;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->listen_fd, &ev) == -1)
+    {
+        perror("epoll_ctl listen");
+        return -1;
+    }
+
+    slotMapInit(&reactor->clients);
+    if (bitsetInit(&reactor->sockets, (size_t)connections_capacity) == -1)
+    {
+        perror("bitsetInit sockets");
+        return -1;
+    }
+    pthread_mutex_init(&reactor->clients_mutex, NULL);
+
+    if (server_config.pin_cpus)
+    {
+        if (server_config.cpu_count > 0)
+            reactor->cpu = server_config.cpus[id % server_config.cpu_count];
+        else
+            reactor->cpu = id % (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    return 0;
+}
+
+/**
+ ** Returns the number of running reactors.
+ * @returns int - The reactor count.
+ */
+int reactorCount(void)
+{
+    return reactor_count;
+}
+
+/**
+ ** Returns a reactor by index.
+ * @param index (int) - The reactor index, from 0 to reactorCount() - 1.
+ * @returns Reactor* - The reactor.
+ */
+Reactor *reactorGet(int index)
+{
+    return &reactors[index];
+}
+
+/**
+ ** Returns the reactor that owns a socket. Safe to call from any thread: the caller must then
+ * lock the reactor's clients_mutex and check that the socket is still in its shard.
+ * @param fd (int) - The client socket file descriptor.
+ * @returns Reactor* - The owning reactor, or NULL if the socket is not managed.
+ */
+Reactor *reactorForSocket(int fd)
+{
+    if (fd < 0 || fd >= connections_capacity)
+        return NULL;
+    return atomic_load(&owners[fd]);
+}
+
+/**
+ ** Returns the connection attached to a socket.
+ * @param fd (int) - The client socket file descriptor.
+ * @returns Connection* - The connection, or NULL if the socket is not managed by the reactor.
+ */
+Connection *reactorGetConnection(int fd)
+{
+    if (fd < 0 || fd >= connections_capacity)
+        return NULL;
+    return atomic_load(&connections[fd]);
+}
+
+/**
+ ** Returns the connection of a socket if it belongs to the given shard.
+ * The caller must hold reactor->clients_mutex, which keeps the connection alive.
+ * @param reactor (Reactor*) - The locked reactor.
+ * @param fd (int) - The client socket file descriptor.
+ * @returns Connection* - The connection, or NULL if the socket is not in this shard.
+ */
+Connection *reactorShardConnection(Reactor *reactor, int fd)
+{
+    if (fd < 0 || fd >= connections_capacity)
+        return NULL;
+    // The owner is checked first: a socket only enters another shard once this one has released it
+    if (atomic_load(&owners[fd]) != reactor)
+        return NULL;
+    return atomic_load(&connections[fd]);
+}
+
+/**
+ ** Finds the connection of a socket and locks its shard, from any thread.
+ * @param fd (int) - The client socket file descriptor.
+ * @returns Connection* - The connection, to release with reactorUnlockConnection, or NULL.
+ */
+Connection *reactorLockConnection(int fd)
+{
+    Reactor *reactor = reactorForSocket(fd);
+
+    if (reactor == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&reactor->clients_mutex);
+    Connection *conn = reactorShardConnection(reactor, fd);
+
+    if (conn == NULL)
+        pthread_mutex_unlock(&reactor->clients_mutex);
+    return conn;
+}
+
+/**
+ ** Releases the shard locked by reactorLockConnection.
+ * @param conn (Connection*) - The connection returned by reactorLockConnection.
+ * @returns void
+ */
+void reactorUnlockConnection(Connection *conn)
+{
+    pthread_mutex_unlock(&conn->reactor->clients_mutex);
+}
+
+/**
+ ** Changes the blocking mode of a socket.
+ * @param fd (int) - The socket.
+ * @param blocking (int) - 1 for blocking mode, 0 for non-blocking mode.
+ * @returns void
+ */
+static void setBlocking(int fd, int blocking)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (blocking)
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    else
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ ** Writes the pending output of a connection. The caller must hold conn->output_mutex.
+ * On a socket error, the connection is shut down and the owning reactor closes it.
+ * @param conn (Connection*) - The connection to flush.
+ * @returns void
+ */
+static void flushOutput(Connection *conn)
+{
+    if (conn->paused || sendQueueIsEmpty(&conn->output))
+        return;
+
+    if (sendQueueFlush(&conn->output, conn->fd) == -1)
+    {
+        conn->closing = 1;
+        sendQueueClear(&conn->output);
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+/**
+ ** Tells whether a message fits in the output of a connection and in the global budget.
+ * @param conn (Connection*) - The recipient. The caller holds conn->output_mutex.
+ * @param length (size_t) - The size of the message.
+ * @returns int - 1 if the message can be queued, 0 otherwise.
+ */
+static int outputHasRoom(Connection *conn, size_t length)
+{
+    return !sendQueueIsFull(&conn->output) &&
+           conn->output.bytes + length <= server_config.queue_limit &&
+           sendQueueTotalBytes() + length <= server_config.global_queue_limit;
+}
+
+/**
+ ** Applies the slow consumer policy when a message does not fit in the output of a connection.
+ * The disconnection only shuts the socket down: the owning reactor then closes it through remove_client.
+ * @param conn (Connection*) - The lagging recipient. The caller holds conn->output_mutex.
+ * @param length (size_t) - The size of the new message.
+ * @returns int - 1 if the new message can now be queued, 0 if it must be dropped.
+ */
+static int makeRoom(Connection *conn, size_t length)
+{
+    if (server_config.slow_policy == POLICY_DISCONNECT)
+    {
+        atomic_fetch_add(&server_stats.slow_disconnects, 1);
+        printf("Client %d trop lent (%zu octets en attente), déconnexion\n", conn->fd, conn->output.bytes);
+        conn->closing = 1;
+        sendQueueClear(&conn->output);
+        shutdown(conn->fd, SHUT_RDWR);
+        return 0;
+    }
+
+    if (server_config.slow_policy == POLICY_DROP_OLDEST)
+    {
+        size_t local_excess = conn->output.bytes + length > server_config.queue_limit
+                                  ? conn->output.bytes + length - server_config.queue_limit
+                                  : 0;
+        size_t total = sendQueueTotalBytes();
+        size_t global_excess = total + length > server_config.global_queue_limit
+                                   ? total + length - server_config.global_queue_limit
+                                   : 0;
+        size_t wanted = local_excess > global_excess ? local_excess : global_excess;
+        int dropped = 0;
+
+        // A full queue of small messages needs at least one slot
+        if (wanted == 0)
+            wanted = 1;
+
+        size_t freed = sendQueueDropOldest(&conn->output, SEND_BROADCAST, wanted, &dropped);
+        atomic_fetch_add(&server_stats.dropped_oldest_messages, dropped);
+        atomic_fetch_add(&server_stats.dropped_oldest_bytes, freed);
+
+        if (outputHasRoom(conn, length))
+            return 1;
+    }
+
+    atomic_fetch_add(&server_stats.dropped_new_messages, 1);
+    atomic_fetch_add(&server_stats.dropped_new_bytes, length);
+    return 0;
+}
+
+/**
+ ** Queues a message for a connection, framed if the client speaks the v2 protocol.
+ * @param conn (Connection*) - The recipient.
+ * @param type (FrameType) - The frame type, ignored for legacy clients.
+ * @param parts (MessageBuffer**) - The shared buffers making up the message.
+ * @param part_count (int) - The number of buffers.
+ * @param flags (int) - SEND_BROADCAST for a broadcast message, 0 otherwise.
+ * @returns void
+ */
+static void queueMessage(Connection *conn, FrameType type, MessageBuffer **parts, int part_count, int flags)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    int header_length = 0;
+    size_t length = 0;
+
+    for (int i = 0; i < part_count; i++)
+    {
+        length += parts[i]->length;
+    }
+
+    pthread_mutex_lock(&conn->output_mutex);
+
+    if (conn->protocol == PROTOCOL_V2)
+    {
+        frameEncodeHeader(header, type, (uint32_t)length);
+        header_length = FRAME_HEADER_SIZE;
+        length += FRAME_HEADER_SIZE;
+    }
+
+    if (conn->closing || (!outputHasRoom(conn, length) && !makeRoom(conn, length)))
+    {
+        pthread_mutex_unlock(&conn->output_mutex);
+        return;
+    }
+
+    int was_empty = sendQueueIsEmpty(&conn->output);
+
+    if (sendQueuePush(&conn->output, header, header_length, parts, part_count, flags) != 0)
+    {
+        atomic_fetch_add(&server_stats.dropped_new_messages, 1);
+        atomic_fetch_add(&server_stats.dropped_new_bytes, length);
+    }
+    else if (was_empty && !conn->corked)
+    {
+        flushOutput(conn);
+    }
+    pthread_mutex_unlock(&conn->output_mutex);
+}
+
+/**
+ ** Holds back the output of a connection while the reactor runs the commands it received,
+ * so that all their responses leave in a single write.
+ * @param conn (Connection*) - The connection.
+ * @returns void
+ */
+static void corkOutput(Connection *conn)
+{
+    pthread_mutex_lock(&conn->output_mutex);
+    conn->corked = 1;
+    pthread_mutex_unlock(&conn->output_mutex);
+}
+
+/**
+ ** Releases the output held back by corkOutput and writes it.
+ * @param conn (Connection*) - The connection.
+ * @returns void
+ */
+static void uncorkOutput(Connection *conn)
+{
+    pthread_mutex_lock(&conn->output_mutex);
+    conn->corked = 0;
+    flushOutput(conn);
+    pthread_mutex_unlock(&conn->output_mutex);
+}
+
+/**
+ ** Queues a message for a connection and writes it at once if nothing is pending.
+ * Never blocks: what the socket does not accept is written when it becomes writable.
+ * When the connection lags too far behind, the slow consumer policy decides what is dropped.
+ * @param conn (Connection*) - The recipient, kept alive by its locked shard or by its own reactor.
+ * @param parts (MessageBuffer**) - The shared buffers making up the message; the queue takes its own references.
+ * @param part_count (int) - The number of buffers.
+ * @param flags (int) - SEND_BROADCAST for a broadcast message, 0 otherwise.
+ * @returns void
+ */
+void connectionSend(Connection *conn, MessageBuffer **parts, int part_count, int flags)
+{
+    queueMessage(conn, FRAME_TEXT, parts, part_count, flags);
+}
+
+/**
+ ** Registers a connection in epoll, in edge-triggered mode.
+ * @param conn (Connection*) - The connection to watch.
+ * @param op (int) - EPOLL_CTL_ADD or EPOLL_CTL_MOD.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int watchConnection(Connection *conn, int op)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    return epoll_ctl(conn->reactor->epoll_fd, op, conn->fd, &ev);
+}
+
+/**
+ ** Releases a connection and closes its socket.
+ * @param conn (Connection*) - The connection to close.
+ * @returns void
+ */
+static void closeConnection(Connection *conn)
+{
+    printf("Client %d déconnecté\n", conn->fd);
+    int fd = conn->fd;
+
+    Reactor *owner = conn->reactor;
+
+    pthread_mutex_lock(&owner->clients_mutex);
+    atomic_store(&connections[fd], NULL);
+    bitsetClear(&owner->sockets, (size_t)fd);
+    pthread_mutex_unlock(&owner->clients_mutex);
+
+    remove_client(conn);
+    // The socket may already have been reused by another reactor once closed
+    atomic_compare_exchange_strong(&owners[fd], &owner, NULL);
+
+    sendQueueClear(&conn->output);
+    pthread_mutex_destroy(&conn->output_mutex);
+    frameDecoderFree(&conn->input);
+    free(conn);
+}
+
+/**
+ ** Stops watching a connection while another thread uses its socket (file transfers).
+ * Messages sent to the connection meanwhile are queued until reactorResume.
+ * @param conn (Connection*) - The connection to suspend.
+ * @returns void
+ */
+void reactorSuspend(Connection *conn)
+{
+    conn->state = CONN_TRANSFER;
+    epoll_ctl(conn->reactor->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+
+    pthread_mutex_lock(&conn->output_mutex);
+    conn->paused = 1;
+    pthread_mutex_unlock(&conn->output_mutex);
+}
+
+/**
+ ** Switches a suspended connection to blocking mode and writes its pending output,
+ * so that the transfer thread starts on an empty stream.
+ * @param conn (Connection*) - The suspended connection.
+ * @returns void
+ */
+void reactorDrain(Connection *conn)
+{
+    setBlocking(conn->fd, 1);
+
+    pthread_mutex_lock(&conn->output_mutex);
+    if (sendQueueFlush(&conn->output, conn->fd) == -1)
+        sendQueueClear(&conn->output);
+    pthread_mutex_unlock(&conn->output_mutex);
+}
+
+/**
+ ** Gives a suspended connection back to the reactor. Data received in the meantime is reported at once.
+ * @param conn (Connection*) - The connection to resume.
+ * @returns void
+ */
+void reactorResume(Connection *conn)
+{
+    setBlocking(conn->fd, 0);
+
+    pthread_mutex_lock(&conn->output_mutex);
+    conn->paused = 0;
+    flushOutput(conn);
+    pthread_mutex_unlock(&conn->output_mutex);
+
+    conn->state = CONN_READY;
+
+    if (watchConnection(conn, EPOLL_CTL_ADD) == -1)
+    {
+        perror("epoll_ctl resume");
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+/**
+ ** Accepts every pending connection on the listening socket of a reactor.
+ * @param reactor (Reactor*) - The reactor whose listener became readable.
+ * @returns void
+ */
+static void acceptClients(Reactor *reactor)
+{
+    while (1)
+    {
+        struct sockaddr_in client_addr;
+        socklen_t addrlen = sizeof(client_addr);
+        int new_socket = accept4(reactor->listen_fd, (struct sockaddr *)&client_addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (new_socket < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+
+        if (new_socket >= connections_capacity)
+        {
+            close(new_socket);
+            continue;
+        }
+
+        Connection *conn = calloc(1, sizeof(Connection));
+
+        if (conn == NULL)
+        {
+            perror("calloc connection");
+            close(new_socket);
+            continue;
+        }
+        conn->fd = new_socket;
+        conn->state = CONN_WAIT_USERNAME;
+        conn->reactor = reactor;
+        conn->addr = client_addr;
+        conn->protocol = PROTOCOL_UNKNOWN;
+        frameDecoderInit(&conn->input);
+        sendQueueInit(&conn->output);
+        pthread_mutex_init(&conn->output_mutex, NULL);
+
+        printf("Nouveau client connecté (socket: %d, reactor: %d)\n", new_socket, reactor->id);
+        atomic_store(&owners[new_socket], reactor);
+
+        pthread_mutex_lock(&reactor->clients_mutex);
+        atomic_store(&connections[new_socket], conn);
+        bitsetSet(&reactor->sockets, (size_t)new_socket);
+        pthread_mutex_unlock(&reactor->clients_mutex);
+        add_client(conn);
+
+        if (watchConnection(conn, EPOLL_CTL_ADD) == -1)
+        {
+            perror("epoll_ctl client");
+            closeConnection(conn);
+            continue;
+        }
+        welcome_client(conn);
+    }
+}
+
+/**
+ ** Answers the HELLO frame of a v2 client, then prompts for its username if it is not logged in yet.
+ * @param conn (Connection*) - The connection.
+ * @returns void
+ */
+static void answerHello(Connection *conn)
+{
+    MessageBuffer *hello = bufferCreate(PROTOCOL_VERSION, strlen(PROTOCOL_VERSION));
+
+    if (hello != NULL)
+    {
+        queueMessage(conn, FRAME_HELLO, &hello, 1, 0);
+        bufferRelease(hello);
+    }
+    if (conn->state == CONN_WAIT_USERNAME)
+        welcome_client(conn);
+}
+
+/**
+ ** Executes every complete frame waiting in the decoder of a v2 connection.
+ * Stops early when a command hands the socket to a transfer thread: the following bytes are its data.
+ * @param conn (Connection*) - The connection.
+ * @returns int - 0 on success, -1 on a protocol error.
+ */
+static int processFrames(Connection *conn)
+{
+    Frame frame;
+    int result = 0;
+
+    while (conn->state != CONN_TRANSFER && (result = frameDecoderNext(&conn->input, &frame)) == 1)
+    {
+        switch (frame.type)
+        {
+        case FRAME_HELLO:
+            answerHello(conn);
+            break;
+        case FRAME_TEXT:
+            handle_client(conn, frame.payload);
+            break;
+        case FRAME_TRANSFER:
+            handle_transfer(conn, frame.payload);
+            break;
+        default:
+            return -1;
+        }
+    }
+    return result == -1 ? -1 : 0;
+}
+
+/**
+ ** Hands every NUL-terminated message of a legacy read to the server.
+ * Legacy clients end their chat messages with a NUL byte, so a burst coalesced by TCP holds several of them.
+ * @param conn (Connection*) - The connection.
+ * @param data (char*) - The bytes received, NUL-terminated.
+ * @param length (size_t) - Number of bytes received.
+ * @returns void
+ */
+static void processLegacy(Connection *conn, char *data, size_t length)
+{
+    char *end = data + length;
+
+    while (data < end && conn->state != CONN_TRANSFER)
+    {
+        size_t message_length = strlen(data);
+
+        handle_client(conn, data);
+        data += message_length + 1;
+
+        // Padding NUL bytes are not messages
+        while (data < end && *data == '\0')
+            data++;
+    }
+}
+
+/**
+ ** Drains a connection and runs its messages. Closes the connection on error or end of stream.
+ * @param conn (Connection*) - The connection.
+ * @returns int - 0 if the connection is still open, -1 if it was closed.
+ */
+static int receiveMessages(Connection *conn)
+{
+    while (conn->state != CONN_TRANSFER)
+    {
+        if (conn->protocol == PROTOCOL_V2 && processFrames(conn) == -1)
+        {
+            fprintf(stderr, "Client %d: trame invalide\n", conn->fd);
+            closeConnection(conn);
+            return -1;
+        }
+        if (conn->state == CONN_TRANSFER)
+            return 0;
+
+        size_t available;
+        char *space = frameDecoderSpace(&conn->input, MAX_MESSAGE_SIZE, &available);
+
+        if (space == NULL)
+        {
+            closeConnection(conn);
+            return -1;
+        }
+        if (conn->protocol != PROTOCOL_V2 && available > MAX_MESSAGE_SIZE - 1)
+            available = MAX_MESSAGE_SIZE - 1;
+
+        int received = recv(conn->fd, space, available, MSG_DONTWAIT);
+
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (received <= 0)
+        {
+            closeConnection(conn);
+            return -1;
+        }
+
+        if (conn->protocol == PROTOCOL_UNKNOWN)
+        {
+            pthread_mutex_lock(&conn->output_mutex);
+            conn->protocol = (unsigned char)space[0] == FRAME_MAGIC ? PROTOCOL_V2 : PROTOCOL_LEGACY;
+            pthread_mutex_unlock(&conn->output_mutex);
+        }
+
+        if (conn->protocol == PROTOCOL_V2)
+        {
+            frameDecoderCommit(&conn->input, received);
+            continue;
+        }
+        space[received] = '\0';
+        processLegacy(conn, space, received);
+    }
+    return 0;
+}
+
+/**
+ ** Reads everything available on a connection and runs every message it contains, in order.
+ * In edge-triggered mode, the socket must be drained until EAGAIN. Output is corked meanwhile:
+ * the responses to a burst of commands are written together once the socket is drained.
+ * @param conn (Connection*) - The connection that became readable.
+ * @returns void
+ */
+static void readConnection(Connection *conn)
+{
+    corkOutput(conn);
+    if (receiveMessages(conn) == 0)
+        uncorkOutput(conn);
+}
+
+/**
+ ** Runs the event loop of one reactor until the shutdown flag is raised.
+ * @param arg (void*) - The reactor to run.
+ * @returns void*
+ */
+static void *reactorThread(void *arg)
+{
+    Reactor *reactor = (Reactor *)arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    if (reactor->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(reactor->cpu, &set);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "Reactor %d: impossible d'épingler sur le CPU %d\n", reactor->id, reactor->cpu);
+    }
+
+    while (!*shutdown_flag)
+    {
+        int count = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, 1000);
+
+        if (count < 0)
+        {
+            if (errno != EINTR)
+                perror("epoll_wait");
+            continue;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            Connection *conn = events[i].data.ptr;
+
+            if (conn == NULL)
+            {
+                acceptClients(reactor);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                pthread_mutex_lock(&conn->output_mutex);
+                flushOutput(conn);
+                pthread_mutex_unlock(&conn->output_mutex);
+            }
+            // Frames left in the decoder by a transfer are run as soon as the connection is resumed
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) || frameDecoderHasFrame(&conn->input))
+            {
+                readConnection(conn);
+            }
+        }
+    }
+    close(reactor->listen_fd);
+    close(reactor->epoll_fd);
+    return NULL;
+}
+
+/**
+ ** Creates the configured number of reactors and starts their threads.
+ * @param shouldShutdown (int*) - Pointer to the shouldShutdown flag, checked every second by each reactor.
+ * @returns int - 0 on success, -1 on error.
+ */
+int reactorStartAll(int *shouldShutdown)
+{
+    shutdown_flag = shouldShutdown;
+    connections_capacity = reactorRaiseFileLimit();
+    connections = calloc(connections_capacity, sizeof(Connection *));
+    owners = calloc(connections_capacity, sizeof(*owners));
+
+    if (connections == NULL || owners == NULL)
+    {
+        perror("calloc connections");
+        return -1;
+    }
+
+    for (int i = 0; i < server_config.reactor_count; i++)
+    {
+        if (reactorInit(&reactors[i], i) == -1)
+            return -1;
+        reactor_count++;
+    }
+
+    for (int i = 0; i < reactor_count; i++)
+    {
+        if (pthread_create(&reactors[i].thread, NULL, reactorThread, &reactors[i]) != 0)
+        {
+            perror("pthread_create reactor");
+            *shouldShutdown = 1;
+            reactor_count = i;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ ** Waits for every reactor thread to stop and releases the connection shards.
+ * @returns void
+ */
+void reactorJoinAll(void)
+{
+    for (int i = 0; i < reactor_count; i++)
+    {
+        pthread_join(reactors[i].thread, NULL);
+        pthread_mutex_lock(&reactors[i].clients_mutex);
+        slotMapFree(&reactors[i].clients);
+        bitsetFree(&reactors[i].sockets);
+        pthread_mutex_unlock(&reactors[i].clients_mutex);
+        pthread_mutex_destroy(&reactors[i].clients_mutex);
+    }
+}
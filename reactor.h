@@ -0,0 +1,82 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include "slotmap.h"
+#include "bitset.h"
+#include "sendqueue.h"
+#include "protocol.h"
+
+#define MAX_MESSAGE_SIZE 2000
+
+// États d'une connexion gérée par le reactor
+typedef enum
+{
+    CONN_WAIT_USERNAME,
+    CONN_WAIT_PASSWORD,
+    CONN_READY,
+    CONN_TRANSFER,
+} ConnectionState;
+
+// Protocole parlé par le client, détecté sur le premier octet reçu
+typedef enum
+{
+    PROTOCOL_UNKNOWN,
+    PROTOCOL_LEGACY,
+    PROTOCOL_V2,
+} Protocol;
+
+// Un reactor: un thread, une instance epoll, un listener et une partie de la table des connexions
+typedef struct reactor
+{
+    int id;
+    int epoll_fd;
+    int listen_fd;
+    int cpu;
+    pthread_t thread;
+    SlotMap clients;
+    Bitset sockets; // Sockets du shard, modifié sous clients_mutex avec connections[]
+    pthread_mutex_t clients_mutex;
+} Reactor;
+
+typedef struct connection
+{
+    int fd;
+    ConnectionState state;
+    Reactor *reactor;
+    char username[100];
+    struct sockaddr_in addr;
+    SlotHandle handle;
+    Protocol protocol;
+    FrameDecoder input;
+    SendQueue output;
+    pthread_mutex_t output_mutex;
+    int paused;
+    int corked;
+    int closing;
+} Connection;
+
+int reactorRaiseFileLimit(void);
+int reactorStartAll(int *shouldShutdown);
+void reactorJoinAll(void);
+int reactorCount(void);
+Reactor *reactorGet(int index);
+Reactor *reactorForSocket(int fd);
+Connection *reactorGetConnection(int fd);
+Connection *reactorLockConnection(int fd);
+void reactorUnlockConnection(Connection *conn);
+Connection *reactorShardConnection(Reactor *reactor, int fd);
+void connectionSend(Connection *conn, MessageBuffer **parts, int part_count, int flags);
+void reactorSuspend(Connection *conn);
+void reactorDrain(Connection *conn);
+void reactorResume(Connection *conn);
+
+// Fonctions appelées par le reactor, implémentées dans server.c
+void add_client(Connection *conn);
+void remove_client(Connection *conn);
+void welcome_client(Connection *conn);
+void handle_client(Connection *conn, char *buffer);
+void handle_transfer(Connection *conn, const char *token);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+#include "registry.h"
+#include "epoch.h"
+
+/**
+ ** Hashes a username with 64-bit FNV-1a.
+ * @param name (const char*) - The username.
+ * @returns uint64_t - Its hash.
+ */
+uint64_t registryHash(const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    while (*name != '\0')
+    {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ ** Allocates an empty table.
+ * @param capacity (size_t) - Number of slots, a power of two.
+ * @returns RegistryTable* - The table, or NULL if memory is exhausted.
+ */
+static RegistryTable *tableCreate(size_t capacity)
+{
+    RegistryTable *table = calloc(1, sizeof(RegistryTable) + capacity * sizeof(RegistryEntry *));
+
+    if (table != NULL)
+        table->capacity = capacity;
+    return table;
+}
+
+/**
+ ** Looks a username up in one table. Safe against a concurrent writer.
+ * @param table (RegistryTable*) - The table, or NULL.
+ * @param hash (uint64_t) - The hash of the username.
+ * @param name (const char*) - The username.
+ * @returns RegistryEntry* - The entry, or NULL if the table does not hold it.
+ */
+static RegistryEntry *tableFind(RegistryTable *table, uint64_t hash, const char *name)
+{
+    if (table == NULL)
+        return NULL;
+
+    size_t mask = table->capacity - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        RegistryEntry *entry = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+
+        if (entry == NULL)
+            return NULL;
+        if (entry->hash == hash && strcmp(entry->name, name) == 0)
+            return entry;
+    }
+}
+
+/**
+ ** Stores an entry in the first free slot of its probe sequence. The table must have room.
+ * The entry is published last: a reader that sees it sees it complete.
+ * @param table (RegistryTable*) - The table.
+ * @param entry (RegistryEntry*) - The entry.
+ * @returns void
+ */
+static void tablePut(RegistryTable *table, RegistryEntry *entry)
+{
+    size_t mask = table->capacity - 1;
+    size_t i = entry->hash & mask;
+
+    while (atomic_load_explicit(&table->slots[i], memory_order_relaxed) != NULL)
+        i = (i + 1) & mask;
+
+    atomic_store_explicit(&table->slots[i], entry, memory_order_release);
+    table->count++;
+}
+
+/**
+ ** Publishes a new pair of tables. The previous view is released once no reader can hold it.
+ * @param registry (Registry*) - The registry, write-locked.
+ * @param current (RegistryTable*) - The table receiving insertions.
+ * @param previous (RegistryTable*) - The table being migrated, or NULL.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+static int publishView(Registry *registry, RegistryTable *current, RegistryTable *previous)
+{
+    RegistryView *view = malloc(sizeof(RegistryView));
+
+    if (view == NULL)
+        return -1;
+    view->current = current;
+    view->previous = previous;
+
+    RegistryView *old = atomic_exchange(&registry->view, view);
+
+    if (old != NULL)
+        epochRetire(old, free);
+    return 0;
+}
+
+/**
+ ** Copies the next batch of entries from the previous table to the current one.
+ * Entries are copied, not removed: the probe sequences of the previous table stay valid for readers.
+ * The count of the previous table is the number of entries still waiting to be copied.
+ * @param registry (Registry*) - The registry, write-locked.
+ * @returns void
+ */
+static void migrateStep(Registry *registry)
+{
+    RegistryView *view = atomic_load_explicit(&registry->view, memory_order_relaxed);
+
+    if (view == NULL || view->previous == NULL)
+        return;
+
+    RegistryTable *previous = view->previous;
+    size_t end = registry->migrated + REGISTRY_MIGRATE_STEP;
+
+    if (end > previous->capacity)
+        end = previous->capacity;
+
+    for (; registry->migrated < end; registry->migrated++)
+    {
+        RegistryEntry *entry = atomic_load_explicit(&previous->slots[registry->migrated], memory_order_relaxed);
+
+        if (entry != NULL)
+        {
+            tablePut(view->current, entry);
+            previous->count--;
+        }
+    }
+
+    // Once everything is copied, readers stop looking at the previous table; it goes when they are gone
+    if (registry->migrated == previous->capacity && publishView(registry, view->current, NULL) == 0)
+        epochRetire(previous, free);
+}
+
+/**
+ ** Starts a resize when the current table is half full: the current table becomes the previous one.
+ * @param registry (Registry*) - The registry, write-locked.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+static int growIfNeeded(Registry *registry)
+{
+    RegistryView *view = atomic_load_explicit(&registry->view, memory_order_relaxed);
+    RegistryTable *current = view != NULL ? view->current : NULL;
+    size_t pending = view != NULL && view->previous != NULL ? view->previous->count : 0;
+
+    // The new table must hold everything still waiting in the previous one, plus the new entry
+    if (current != NULL && (current->count + pending + 1) * 2 <= current->capacity)
+        return 0;
+
+    // A resize is only started once the previous one is finished
+    while (view != NULL && view->previous != NULL)
+    {
+        migrateStep(registry);
+
+        RegistryView *next = atomic_load_explicit(&registry->view, memory_order_relaxed);
+
+        // The final step could not publish its view: memory is exhausted
+        if (next == view && registry->migrated == view->previous->capacity)
+            return -1;
+        view = next;
+    }
+
+    RegistryTable *table = tableCreate(current == NULL ? REGISTRY_MIN_CAPACITY : current->capacity * 2);
+
+    if (table == NULL)
+        return -1;
+
+    int empty = current == NULL || current->count == 0;
+
+    if (publishView(registry, table, empty ? NULL : current) != 0)
+    {
+        free(table);
+        return -1;
+    }
+    registry->migrated = 0;
+    if (current != NULL && empty)
+        epochRetire(current, free);
+    return 0;
+}
+
+/**
+ ** Finds a user by username, without taking any lock.
+ * @param registry (Registry*) - The registry.
+ * @param name (const char*) - The username.
+ * @returns RegistryEntry* - The entry, or NULL if there is none. Its user must be read inside an epoch.
+ */
+RegistryEntry *registryFind(Registry *registry, const char *name)
+{
+    uint64_t hash = registryHash(name);
+
+    epochEnter();
+    RegistryView *view = atomic_load_explicit(&registry->view, memory_order_acquire);
+    RegistryEntry *entry = NULL;
+
+    if (view != NULL)
+    {
+        entry = tableFind(view->current, hash, name);
+        if (entry == NULL)
+            entry = tableFind(view->previous, hash, name);
+    }
+    epochExit();
+    return entry;
+}
+
+/**
+ ** Adds a user, unless the username is already taken.
+ * @param registry (Registry*) - The registry.
+ * @param user (User*) - The user; the registry owns it on success.
+ * @param socket_fd (int) - The socket the user is logged in on, or -1.
+ * @param inserted (RegistryEntry**) - Receives the new entry; may be NULL.
+ * @returns int - 0 on success, 1 if the username exists, -1 if memory is exhausted.
+ */
+int registryInsert(Registry *registry, User *user, int socket_fd, RegistryEntry **inserted)
+{
+    uint64_t hash = registryHash(user->name);
+
+    pthread_mutex_lock(&registry->write_lock);
+
+    RegistryView *view = atomic_load_explicit(&registry->view, memory_order_relaxed);
+
+    if (view != NULL && (tableFind(view->current, hash, user->name) != NULL || tableFind(view->previous, hash, user->name) != NULL))
+    {
+        pthread_mutex_unlock(&registry->write_lock);
+        return 1;
+    }
+
+    RegistryEntry *entry = calloc(1, sizeof(RegistryEntry));
+
+    if (entry == NULL || growIfNeeded(registry) != 0)
+    {
+        pthread_mutex_unlock(&registry->write_lock);
+        free(entry);
+        return -1;
+    }
+
+    entry->hash = hash;
+    strcpy(entry->name, user->name);
+    atomic_init(&entry->user, user);
+    atomic_init(&entry->socket_fd, socket_fd);
+
+    view = atomic_load_explicit(&registry->view, memory_order_relaxed);
+    tablePut(view->current, entry);
+    migrateStep(registry);
+    atomic_fetch_add(&registry->count, 1);
+    pthread_mutex_unlock(&registry->write_lock);
+
+    if (inserted != NULL)
+        *inserted = entry;
+    return 0;
+}
+
+/**
+ ** Publishes a new version of a user, if the current one is still the expected version.
+ * The replaced version is released once no reader can hold it.
+ * @param entry (RegistryEntry*) - The entry of the user.
+ * @param expected (User*) - The version the change was based on.
+ * @param replacement (User*) - The new version, with the same name; the registry owns it on success.
+ * @returns int - 0 on success, 1 if another writer replaced the user in the meantime.
+ */
+int registryReplace(RegistryEntry *entry, User *expected, User *replacement)
+{
+    if (!atomic_compare_exchange_strong(&entry->user, &expected, replacement))
+        return 1;
+
+    epochRetire(expected, free);
+    return 0;
+}
+
+/**
+ ** Calls a function on the current version of every user, without blocking writers.
+ * Users inserted meanwhile may or may not be visited; the others are visited exactly once.
+ * @param registry (Registry*) - The registry.
+ * @param callback (void (*)(User*, void*)) - Called once per user, inside an epoch.
+ * @param arg (void*) - Passed to the callback.
+ * @returns void
+ */
+void registryForEach(Registry *registry, void (*callback)(User *user, void *arg), void *arg)
+{
+    epochEnter();
+
+    RegistryView *view = atomic_load_explicit(&registry->view, memory_order_acquire);
+
+    // The previous table receives no insertion: visiting it first, then skipping its entries
+    // in the current table, cannot miss an entry copied while the walk is running
+    for (size_t i = 0; view != NULL && view->previous != NULL && i < view->previous->capacity; i++)
+    {
+        RegistryEntry *entry = atomic_load_explicit(&view->previous->slots[i], memory_order_acquire);
+
+        if (entry != NULL)
+            callback(atomic_load(&entry->user), arg);
+    }
+    for (size_t i = 0; view != NULL && i < view->current->capacity; i++)
+    {
+        RegistryEntry *entry = atomic_load_explicit(&view->current->slots[i], memory_order_acquire);
+
+        if (entry != NULL && tableFind(view->previous, entry->hash, entry->name) == NULL)
+            callback(atomic_load(&entry->user), arg);
+    }
+    epochExit();
+}
+
+/**
+ ** Returns the number of users in the registry.
+ * @param registry (Registry*) - The registry.
+ * @returns size_t - The number of users.
+ */
+size_t registryCount(Registry *registry)
+{
+    return atomic_load(&registry->count);
+}
+
+/**
+ ** Releases a registry: its tables, entries and users. No reader may be using it any more.
+ * @param registry (Registry*) - The registry.
+ * @returns void
+ */
+void registryDestroy(Registry *registry)
+{
+    pthread_mutex_lock(&registry->write_lock);
+
+    RegistryView *view = atomic_exchange(&registry->view, NULL);
+
+    if (view != NULL)
+    {
+        // Every entry is in the current table or, not copied yet, after the cursor of the previous one
+        for (size_t i = 0; i < view->current->capacity; i++)
+        {
+            RegistryEntry *entry = atomic_load(&view->current->slots[i]);
+
+            if (entry != NULL)
+            {
+                free(atomic_load(&entry->user));
+                free(entry);
+            }
+        }
+        for (size_t i = registry->migrated; view->previous != NULL && i < view->previous->capacity; i++)
+        {
+            RegistryEntry *entry = atomic_load(&view->previous->slots[i]);
+
+            if (entry != NULL)
+            {
+                free(atomic_load(&entry->user));
+                free(entry);
+            }
+        }
+        free(view->current);
+        free(view->previous);
+        free(view);
+    }
+    registry->migrated = 0;
+    atomic_store(&registry->count, 0);
+    pthread_mutex_unlock(&registry->write_lock);
+}
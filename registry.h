@@ -0,0 +1,64 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "user.h"
+
+#define REGISTRY_MIN_CAPACITY 64
+#define REGISTRY_MIGRATE_STEP 64
+
+// Entrée d'un utilisateur. Elle n'est jamais libérée tant que le registre existe: un pointeur
+// obtenu par registryFind reste valable. La version courante de l'utilisateur (immuable) est
+// remplacée d'un bloc par registryReplace; socket_fd vaut -1 quand l'utilisateur n'est pas connecté.
+typedef struct registry_entry
+{
+    uint64_t hash;
+    char name[50];
+    _Atomic(User *) user;
+    atomic_int socket_fd;
+} RegistryEntry;
+
+typedef struct registry_table
+{
+    size_t capacity;
+    size_t count;
+    _Atomic(RegistryEntry *) slots[];
+} RegistryTable;
+
+// Tables lues par les recherches, remplacées ensemble au début et à la fin d'un agrandissement
+typedef struct registry_view
+{
+    RegistryTable *current;
+    RegistryTable *previous;
+} RegistryView;
+
+/*
+ * Table des utilisateurs indexée par pseudo, à sondage linéaire.
+ * Les lecteurs ne prennent aucun verrou: ils lisent la vue publiée à l'intérieur d'une époque
+ * (epoch.h), et les tables, vues et versions d'utilisateurs remplacées ne sont libérées qu'après
+ * leur sortie. Les écrivains sont sérialisés par write_lock. Quand la table est à moitié pleine,
+ * une table deux fois plus grande est créée et les entrées y sont recopiées par petits lots
+ * à chaque insertion: aucune écriture ne paie la copie de toute la table.
+ */
+typedef struct registry
+{
+    _Atomic(RegistryView *) view;
+    size_t migrated;
+    atomic_size_t count;
+    pthread_mutex_t write_lock;
+} Registry;
+
+#define REGISTRY_INITIALIZER {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER}
+
+uint64_t registryHash(const char *name);
+RegistryEntry *registryFind(Registry *registry, const char *name);
+int registryInsert(Registry *registry, User *user, int socket_fd, RegistryEntry **inserted);
+int registryReplace(RegistryEntry *entry, User *expected, User *replacement);
+void registryForEach(Registry *registry, void (*callback)(User *user, void *arg), void *arg);
+size_t registryCount(Registry *registry);
+void registryDestroy(Registry *registry);
+
+#endif
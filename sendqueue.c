@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include "sendqueue.h"
+
+#define FLUSH_BATCH 64
+#define INITIAL_CAPACITY 8
+
+// Octets en attente dans toutes les files du serveur
+static atomic_size_t total_queued_bytes = 0;
+
+/**
+ ** Returns the number of bytes waiting in every send queue of the server.
+ * @returns size_t - The total of queued bytes.
+ */
+size_t sendQueueTotalBytes(void)
+{
+    return atomic_load(&total_queued_bytes);
+}
+
+/**
+ ** Initializes an empty send queue.
+ * @param queue (SendQueue*) - The queue to initialize.
+ * @returns void
+ */
+void sendQueueInit(SendQueue *queue)
+{
+    queue->entries = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+    queue->count = 0;
+    queue->offset = 0;
+    queue->bytes = 0;
+}
+
+/**
+ ** Tells whether a send queue has nothing left to write.
+ * @param queue (const SendQueue*) - The queue to check.
+ * @returns int - 1 if the queue is empty, 0 otherwise.
+ */
+int sendQueueIsEmpty(const SendQueue *queue)
+{
+    return queue->count == 0;
+}
+
+/**
+ ** Doubles the capacity of the ring, keeping messages in order.
+ * @param queue (SendQueue*) - The queue to grow.
+ * @returns int - 0 on success, -1 if out of memory.
+ */
+static int sendQueueGrow(SendQueue *queue)
+{
+    int capacity = queue->capacity == 0 ? INITIAL_CAPACITY : queue->capacity * 2;
+
+    if (capacity > SEND_QUEUE_MAX_MESSAGES)
+        capacity = SEND_QUEUE_MAX_MESSAGES;
+
+    SendEntry *entries = malloc(capacity * sizeof(SendEntry));
+
+    if (entries == NULL)
+        return -1;
+
+    for (int i = 0; i < queue->count; i++)
+    {
+        entries[i] = queue->entries[(queue->head + i) % queue->capacity];
+    }
+    free(queue->entries);
+    queue->entries = entries;
+    queue->capacity = capacity;
+    queue->head = 0;
+    return 0;
+}
+
+/**
+ ** Tells whether a send queue has reached its maximum number of messages.
+ * @param queue (const SendQueue*) - The queue to check.
+ * @returns int - 1 if no message can be added, 0 otherwise.
+ */
+int sendQueueIsFull(const SendQueue *queue)
+{
+    return queue->count == SEND_QUEUE_MAX_MESSAGES;
+}
+
+/**
+ ** Appends a message made of shared buffers at the end of a send queue. Only the prefix is copied:
+ * the queue takes a reference on each buffer. Byte limits are enforced by the caller.
+ * @param queue (SendQueue*) - The queue to append to.
+ * @param prefix (const void*) - Bytes written before the buffers, such as a frame header, may be NULL.
+ * @param prefix_length (int) - The prefix length, at most SEND_ENTRY_MAX_PREFIX.
+ * @param parts (MessageBuffer**) - The buffers to write one after the other.
+ * @param part_count (int) - The number of buffers, at most SEND_ENTRY_MAX_PARTS.
+ * @param flags (int) - SEND_BROADCAST for a broadcast message, 0 otherwise.
+ * @returns int - 0 on success, -1 if the queue is full or out of memory.
+ */
+int sendQueuePush(SendQueue *queue, const void *prefix, int prefix_length, MessageBuffer **parts, int part_count, int flags)
+{
+    size_t length = prefix_length;
+
+    for (int i = 0; i < part_count; i++)
+    {
+        length += parts[i]->length;
+    }
+    if (length == 0)
+        return 0;
+    if (sendQueueIsFull(queue))
+        return -1;
+
+    if (queue->count == queue->capacity && sendQueueGrow(queue) != 0)
+        return -1;
+
+    SendEntry *entry = &queue->entries[(queue->head + queue->count) % queue->capacity];
+
+    if (prefix_length > 0)
+        memcpy(entry->prefix, prefix, prefix_length);
+    entry->prefix_length = prefix_length;
+
+    for (int i = 0; i < part_count; i++)
+    {
+        entry->parts[i] = bufferRetain(parts[i]);
+    }
+    entry->part_count = part_count;
+    entry->length = length;
+    entry->flags = flags;
+    queue->count++;
+    queue->bytes += length;
+    atomic_fetch_add(&total_queued_bytes, length);
+    return 0;
+}
+
+/**
+ ** Drops the references held by a message.
+ * @param entry (SendEntry*) - The message.
+ * @returns void
+ */
+static void releaseEntry(SendEntry *entry)
+{
+    for (int i = 0; i < entry->part_count; i++)
+    {
+        bufferRelease(entry->parts[i]);
+        entry->parts[i] = NULL;
+    }
+    entry->part_count = 0;
+}
+
+/**
+ ** Removes the first message of the queue.
+ * @param queue (SendQueue*) - The queue.
+ * @returns void
+ */
+static void sendQueuePop(SendQueue *queue)
+{
+    SendEntry *entry = &queue->entries[queue->head];
+
+    queue->bytes -= entry->length;
+    atomic_fetch_sub(&total_queued_bytes, entry->length);
+    releaseEntry(entry);
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    queue->offset = 0;
+}
+
+/**
+ ** Writes as much of the queue as the socket accepts, several messages per writev() call.
+ * Partially written messages stay at the head of the queue with their offset.
+ * @param queue (SendQueue*) - The queue to flush.
+ * @param fd (int) - The socket to write to.
+ * @returns int - 1 if the queue was emptied, 0 if the socket is full, -1 on a socket error.
+ */
+int sendQueueFlush(SendQueue *queue, int fd)
+{
+    while (queue->count > 0)
+    {
+        struct iovec iov[FLUSH_BATCH];
+        int iovcnt = 0;
+
+        for (int i = 0; i < queue->count && iovcnt + SEND_ENTRY_MAX_PARTS + 1 <= FLUSH_BATCH; i++)
+        {
+            SendEntry *entry = &queue->entries[(queue->head + i) % queue->capacity];
+            size_t skip = i == 0 ? queue->offset : 0;
+
+            if (skip < (size_t)entry->prefix_length)
+            {
+                iov[iovcnt].iov_base = entry->prefix + skip;
+                iov[iovcnt].iov_len = entry->prefix_length - skip;
+                iovcnt++;
+                skip = 0;
+            }
+            else
+            {
+                skip -= entry->prefix_length;
+            }
+
+            for (int part = 0; part < entry->part_count; part++)
+            {
+                MessageBuffer *buffer = entry->parts[part];
+
+                if (skip >= buffer->length)
+                {
+                    skip -= buffer->length;
+                    continue;
+                }
+                iov[iovcnt].iov_base = buffer->data + skip;
+                iov[iovcnt].iov_len = buffer->length - skip;
+                iovcnt++;
+                skip = 0;
+            }
+        }
+
+        ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+
+        size_t remaining = (size_t)written;
+
+        while (remaining > 0)
+        {
+            SendEntry *entry = &queue->entries[queue->head];
+            size_t left = entry->length - queue->offset;
+
+            if (remaining < left)
+            {
+                queue->offset += remaining;
+                break;
+            }
+            remaining -= left;
+            sendQueuePop(queue);
+        }
+    }
+    return 1;
+}
+
+/**
+ ** Drops the oldest messages carrying the given flags until enough bytes are freed.
+ * A message already partially written is never dropped, the stream would be corrupted.
+ * @param queue (SendQueue*) - The queue.
+ * @param flags (int) - Only messages with these flags may be dropped (e.g. SEND_BROADCAST).
+ * @param wanted (size_t) - The number of bytes to free.
+ * @param dropped (int*) - Receives the number of dropped messages.
+ * @returns size_t - The number of bytes freed.
+ */
+size_t sendQueueDropOldest(SendQueue *queue, int flags, size_t wanted, int *dropped)
+{
+    size_t freed = 0;
+    int kept = 0;
+
+    *dropped = 0;
+
+    for (int i = 0; i < queue->count; i++)
+    {
+        SendEntry *entry = &queue->entries[(queue->head + i) % queue->capacity];
+        int in_progress = i == 0 && queue->offset > 0;
+
+        if (freed < wanted && !in_progress && (entry->flags & flags) == flags)
+        {
+            freed += entry->length;
+            releaseEntry(entry);
+            (*dropped)++;
+            continue;
+        }
+        queue->entries[(queue->head + kept) % queue->capacity] = *entry;
+        kept++;
+    }
+    queue->count = kept;
+    queue->bytes -= freed;
+    atomic_fetch_sub(&total_queued_bytes, freed);
+    return freed;
+}
+
+/**
+ ** Drops every message of the queue and releases its storage.
+ * @param queue (SendQueue*) - The queue to clear.
+ * @returns void
+ */
+void sendQueueClear(SendQueue *queue)
+{
+    while (queue->count > 0)
+    {
+        sendQueuePop(queue);
+    }
+    free(queue->entries);
+    sendQueueInit(queue);
+}
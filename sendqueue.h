@@ -0,0 +1,46 @@
+#ifndef SENDQUEUE_H
+#define SENDQUEUE_H
+
+#include <stddef.h>
+#include "buffer.h"
+
+#define SEND_QUEUE_MAX_MESSAGES 1024
+#define SEND_ENTRY_MAX_PARTS 2
+#define SEND_ENTRY_MAX_PREFIX 8
+
+// Drapeaux d'un message en attente
+#define SEND_BROADCAST 1
+
+// Un message en attente d'envoi: un court préfixe propre au destinataire (en-tête de trame)
+// puis des références vers des tampons partagés, écrits à la suite
+typedef struct send_entry
+{
+    unsigned char prefix[SEND_ENTRY_MAX_PREFIX];
+    int prefix_length;
+    MessageBuffer *parts[SEND_ENTRY_MAX_PARTS];
+    int part_count;
+    size_t length;
+    int flags;
+} SendEntry;
+
+// File d'envoi bornée d'une connexion (tampon circulaire, alloué au premier message)
+typedef struct send_queue
+{
+    SendEntry *entries;
+    int capacity;
+    int head;
+    int count;
+    size_t offset;
+    size_t bytes;
+} SendQueue;
+
+void sendQueueInit(SendQueue *queue);
+int sendQueuePush(SendQueue *queue, const void *prefix, int prefix_length, MessageBuffer **parts, int part_count, int flags);
+int sendQueueFlush(SendQueue *queue, int fd);
+int sendQueueIsEmpty(const SendQueue *queue);
+int sendQueueIsFull(const SendQueue *queue);
+size_t sendQueueDropOldest(SendQueue *queue, int flags, size_t wanted, int *dropped);
+void sendQueueClear(SendQueue *queue);
+size_t sendQueueTotalBytes(void);
+
+#endif
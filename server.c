@@ -1,125 +1,153 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
+#include <signal.h>
 #include "ChainedList.h"
 #include "command.h"
 #include "user.h"
 #include "cJSON.h"
+#include "reactor.h"
+#include "config.h"
+#include "protocol.h"
+#include "transfer.h"
+#include "stats.h"
+#include "session.h"
+#include "channel.h"
+#include "msglog.h"
+#include "arena.h"
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
 
-#define MAX_MESSAGE_SIZE 2000
 #define MAX_CLIENTS 10
+#define SENDFILE_CHUNK (64L * 1024 * 1024)
+#define SPLICE_CHUNK (1024 * 1024)
 
-List *client_sockets;
-pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
-extern pthread_mutex_t users_mutex;
 int *shouldShutdown;
 
 void sendAllClients(const char *message);
+void broadcastBuffers(MessageBuffer **parts, int part_count);
 void send_client(int socket_fd, const char *message);
-void remove_client(int socket_fd);
-void add_client(int socket_fd);
-void *handle_client(void *arg);
+void send_client_data(int socket_fd, const void *data, size_t length);
+void remove_client(Connection *conn);
+void add_client(Connection *conn);
 void sendFileContent(int client, const char *filename);
-void upload(int socketFd, const char *filename);
+void upload(int socketFd, const char *argument);
 void download(int socketFd, const char *input);
 void create_directory(const char *dir);
-void handle_login(int client_socket);
+void handle_login(Connection *conn, const char *input);
 
-void add_client(int socket_fd)
+typedef struct transfer
 {
-    pthread_mutex_lock(&clients_mutex);
-    addLast(client_sockets, socket_fd);
-    pthread_mutex_unlock(&clients_mutex);
+    Connection *conn;
+    int is_upload;
+    char argument[MAX_MESSAGE_SIZE];
+} Transfer;
+
+typedef struct data_transfer
+{
+    Connection *conn;
+    TransferOffer offer;
+} DataTransfer;
+
+void add_client(Connection *conn)
+{
+    Reactor *reactor = conn->reactor;
+
+    pthread_mutex_lock(&reactor->clients_mutex);
+    conn->handle = slotMapInsert(&reactor->clients, conn->fd);
+    pthread_mutex_unlock(&reactor->clients_mutex);
 }
 
-void remove_client(int socket_fd)
+void remove_client(Connection *conn)
 {
-    pthread_mutex_lock(&clients_mutex);
-    if (!isListEmpty(client_sockets))
-    {
-        Node *current = client_sockets->first;
-        while (current != NULL)
-        {
-            if (current->val == socket_fd)
-            {
-                close(socket_fd);
-                break;
-            }
-            current = current->next;
-        }
-        removeElement(client_sockets, socket_fd);
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    Reactor *reactor = conn->reactor;
+
+    // Out of its channel before the socket can be reused by another client
+    channelLeave(conn->fd);
+    sessionClose(conn->fd);
+
+    pthread_mutex_lock(&reactor->clients_mutex);
+    slotMapRemove(&reactor->clients, conn->handle);
+    conn->handle = SLOT_HANDLE_INVALID;
+    close(conn->fd);
+    pthread_mutex_unlock(&reactor->clients_mutex);
 }
 
-void send_client(int socket_fd, const char *message)
+void send_client_data(int socket_fd, const void *data, size_t length)
 {
-    pthread_mutex_lock(&clients_mutex);
-    if (isListEmpty(client_sockets))
-    {
-        pthread_mutex_unlock(&clients_mutex);
+    Connection *conn = reactorLockConnection(socket_fd);
+
+    if (conn == NULL)
         return;
+
+    MessageBuffer *buffer = bufferCreate(data, length);
+
+    if (buffer != NULL)
+    {
+        connectionSend(conn, &buffer, 1, 0);
+        bufferRelease(buffer);
     }
+    reactorUnlockConnection(conn);
+}
 
-    Node *current = client_sockets->first;
+void send_client(int socket_fd, const char *message)
+{
+    send_client_data(socket_fd, message, strlen(message) + 1);
+}
 
-    while (current != NULL)
+void broadcastBuffers(MessageBuffer **parts, int part_count)
+{
+    // Each shard is locked in turn: a broadcast never holds two reactor locks at once.
+    // Every recipient only takes a reference on the same buffers, nothing is copied.
+    for (int i = 0; i < reactorCount(); i++)
     {
-        if (current->val == socket_fd)
+        Reactor *reactor = reactorGet(i);
+        pthread_mutex_lock(&reactor->clients_mutex);
+
+        for (size_t j = 0; j < reactor->clients.count; j++)
         {
-            send(socket_fd, message, strlen(message) + 1, 0);
-            break;
+            Connection *conn = reactorShardConnection(reactor, reactor->clients.values[j]);
+
+            if (conn != NULL)
+                connectionSend(conn, parts, part_count, SEND_BROADCAST);
         }
-        current = current->next;
+        pthread_mutex_unlock(&reactor->clients_mutex);
     }
-    pthread_mutex_unlock(&clients_mutex);
 }
 
 void sendAllClients(const char *message)
 {
-    pthread_mutex_lock(&clients_mutex);
+    MessageBuffer *buffer = bufferCreate(message, strlen(message) + 1);
 
-    if (isListEmpty(client_sockets))
-    {
-        pthread_mutex_unlock(&clients_mutex);
+    if (buffer == NULL)
         return;
-    }
-
-    Node *current = client_sockets->first;
 
-    while (current != NULL)
-    {
-        send(current->val, message, strlen(message) + 1, 0);
-        current = current->next;
-    }
-    pthread_mutex_unlock(&clients_mutex);
+    broadcastBuffers(&buffer, 1);
+    bufferRelease(buffer);
 }
 
-void *handle_client(void *arg)
+void welcome_client(Connection *conn)
 {
-    int socket_fd = *((int *)arg);
-    free(arg);
-    handle_login(socket_fd);
-    char buffer[MAX_MESSAGE_SIZE];
+    send_client_data(conn->fd, "Entrez votre pseudo: ", 22);
+}
 
-    while (!*shouldShutdown)
+void handle_client(Connection *conn, char *buffer)
+{
+    if (conn->state != CONN_READY)
     {
-        int received = recv(socket_fd, buffer, sizeof(buffer) - 1, 0);
-        if (received <= 0)
-        {
-            break;
-        }
-        buffer[received] = '\0';
-        printf("Client %d: %s\n", socket_fd, buffer);
-        executeCommand(socket_fd, buffer, shouldShutdown);
+        handle_login(conn, buffer);
+        return;
     }
-    printf("Client %d déconnecté\n", socket_fd);
-    remove_client(socket_fd);
-    return NULL;
+    printf("Client %d: %s\n", conn->fd, buffer);
+    executeCommand(conn->fd, buffer, shouldShutdown);
 }
 
 void sendFileContent(int client, const char *filename)
@@ -129,16 +157,33 @@ void sendFileContent(int client, const char *filename)
     if (!file)
         return;
 
+    Connection *conn = reactorGetConnection(client);
+    int framed = conn != NULL && conn->protocol == PROTOCOL_V2;
+    char content[MAX_MESSAGE_SIZE];
+    size_t length = 0;
     char line[1024];
 
+    // v2 clients get the whole file in one frame, legacy clients keep the line by line stream and its end marker
     while (fgets(line, sizeof(line), file))
     {
         line[strcspn(line, "\n")] = '\0';
-        send(client, line, strlen(line), 0);
-        send(client, "\n", 1, 0);
+
+        if (!framed)
+        {
+            send_client_data(client, line, strlen(line));
+            send_client_data(client, "\n", 1);
+        }
+        else if (length < sizeof(content))
+        {
+            length += snprintf(content + length, sizeof(content) - length, "%s\n", line);
+        }
     }
     fclose(file);
-    send(client, "__END__", 7, 0);
+
+    if (framed)
+        send_client_data(client, content, length < sizeof(content) ? length : sizeof(content) - 1);
+    else
+        send_client_data(client, "__END__", 7);
 }
 
 void create_directory(const char *dir)
@@ -154,53 +199,287 @@ void create_directory(const char *dir)
     }
 }
 
-void upload(int socketFd, const char *filename)
+void transfer_reply(Connection *conn, const char *message, size_t length)
 {
-    if (strstr(filename, "..") != NULL)
+    send(conn->fd, message, length, 0);
+}
+
+int transfer_read_message(Connection *conn, char *buffer, size_t size)
+{
+    int length = recv(conn->fd, buffer, size - 1, 0);
+
+    if (length > 0)
+        buffer[length] = '\0';
+    return length;
+}
+
+void notify_owner(const TransferOffer *offer, const char *message)
+{
+    Connection *conn = reactorLockConnection(offer->owner_fd);
+
+    if (conn == NULL)
+        return;
+
+    // The socket number may have been reused since the transfer was announced
+    if (conn->state == CONN_READY && strcmp(conn->username, offer->owner) == 0)
     {
-        send(socketFd, "Nom de fichier invalide.\n", 26, 0);
+        MessageBuffer *buffer = bufferCreate(message, strlen(message));
+
+        if (buffer != NULL)
+        {
+            connectionSend(conn, &buffer, 1, 0);
+            bufferRelease(buffer);
+        }
+    }
+    reactorUnlockConnection(conn);
+}
+
+int transfer_read_raw(Connection *conn, void *buffer, size_t size)
+{
+    // Bytes read by the reactor after the command belong to the file
+    if (frameDecoderPending(&conn->input) > 0)
+        return (int)frameDecoderTake(&conn->input, buffer, size);
+    return recv(conn->fd, buffer, size, 0);
+}
+
+void transfer_progress(const char *action, const char *filename, long done, long total, struct timespec *last)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec <= last->tv_sec)
         return;
+
+    if (total > 0)
+        printf("%s de '%s': %ld/%ld octets (%.1f%%)\n", action, filename, done, total, (float)done / total * 100);
+    else
+        printf("%s de '%s': %ld octets\n", action, filename, done);
+    *last = now;
+}
+
+int write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return -1;
+        data += written;
+        length -= written;
     }
+    return 0;
+}
 
-    printf("Démarrage de l'upload du fichier: %s\n", filename);
-    create_directory("uploads");
-    printf("Répertoire 'uploads' vérifié.\n");
+long receive_file_data(Connection *conn, int fd, long expected, const char *filename)
+{
+    char buffer[65536];
+    long total = 0;
+    struct timespec last;
 
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "uploads/%s", filename);
-    printf("Sauvegarde vers: %s\n", filepath);
-    FILE *fp = fopen(filepath, "wb");
+    clock_gettime(CLOCK_MONOTONIC, &last);
 
-    if (fp == NULL)
+    // Bytes already read by the reactor after the command are the start of the file
+    while (total < expected && frameDecoderPending(&conn->input) > 0)
     {
-        perror("Erreur lors de l'ouverture du fichier pour écriture");
-        send(socketFd, "Erreur serveur: impossible de créer le fichier.\n", 48, 0);
-        return;
+        size_t wanted = expected - total < (long)sizeof(buffer) ? (size_t)(expected - total) : sizeof(buffer);
+        size_t taken = frameDecoderTake(&conn->input, buffer, wanted);
+
+        if (write_all(fd, buffer, taken) != 0)
+            return -1;
+        total += taken;
+    }
+
+    // The rest goes from the socket to the file through a pipe, without being copied to user space
+    int pipefd[2];
+    int spliced = pipe2(pipefd, O_CLOEXEC) == 0;
+
+    if (spliced)
+        fcntl(pipefd[1], F_SETPIPE_SZ, SPLICE_CHUNK);
+
+    while (total < expected)
+    {
+        size_t wanted = expected - total < SPLICE_CHUNK ? (size_t)(expected - total) : SPLICE_CHUNK;
+        ssize_t received;
+
+        if (spliced)
+        {
+            received = splice(conn->fd, NULL, pipefd[1], NULL, wanted, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+            // Some sockets or file systems do not support splice: fall back to plain copies
+            if (received < 0 && errno == EINVAL && total == 0)
+            {
+                close(pipefd[0]);
+                close(pipefd[1]);
+                spliced = 0;
+                continue;
+            }
+            for (ssize_t pending = received; pending > 0;)
+            {
+                ssize_t moved = splice(pipefd[0], NULL, fd, NULL, pending, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+                if (moved < 0 && errno == EINTR)
+                    continue;
+                if (moved <= 0)
+                {
+                    received = -1;
+                    break;
+                }
+                pending -= moved;
+            }
+        }
+        else
+        {
+            received = recv(conn->fd, buffer, wanted < sizeof(buffer) ? wanted : sizeof(buffer), 0);
+
+            if (received > 0 && write_all(fd, buffer, received) != 0)
+                received = -1;
+        }
+
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+        total += received;
+        transfer_progress("Réception", filename, total, expected, &last);
+    }
+
+    if (spliced)
+    {
+        close(pipefd[0]);
+        close(pipefd[1]);
     }
+    return total;
+}
+
+long receive_legacy_data(Connection *conn, int fd, const char *filename)
+{
+    // The end marker arrives in its own packet, so legacy uploads keep reading small chunks
     char buffer[1024];
     int len;
-    int total = 0;
-    printf("En attente des données...\n");
+    long total = 0;
+    struct timespec last;
 
-    while ((len = recv(socketFd, buffer, sizeof(buffer), 0)) > 0)
+    clock_gettime(CLOCK_MONOTONIC, &last);
+
+    while ((len = transfer_read_raw(conn, buffer, sizeof(buffer))) > 0)
     {
         if (len == 7 && strncmp(buffer, "__END__", 7) == 0)
         {
             printf("Marqueur de fin détecté.\n");
             break;
         }
+        if (write_all(fd, buffer, len) != 0)
+            return -1;
         total += len;
-        printf("Reçu %d octets (total: %d)\n", len, total);
-        fwrite(buffer, 1, len, fp);
-        fflush(fp);
+        transfer_progress("Réception", filename, total, -1, &last);
     }
-    fclose(fp);
-    printf("Fichier reçu et sauvegardé: %s (%d octets)\n", filepath, total);
-    send(socketFd, "Fichier reçu avec succès\n", 26, 0);
+    return total;
 }
 
-void download(int socketFd, const char *input)
+int store_upload(Connection *conn, const char *filename, long expected, char *response, size_t size)
+{
+    printf("Démarrage de l'upload du fichier: %s\n", filename);
+    create_directory("uploads");
+
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "uploads/%s", filename);
+    printf("Sauvegarde vers: %s\n", filepath);
+    int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        perror("Erreur lors de l'ouverture du fichier pour écriture");
+        snprintf(response, size, "Erreur serveur: impossible de créer le fichier.\n");
+        return -1;
+    }
+    // Reserving the blocks up front keeps the file contiguous and fails early when the disk is full
+    if (expected > 0 && fallocate(fd, 0, 0, expected) != 0 && errno != EOPNOTSUPP)
+    {
+        perror("fallocate");
+        close(fd);
+        unlink(filepath);
+        snprintf(response, size, "Erreur serveur: espace disque insuffisant.\n");
+        return -1;
+    }
+
+    // Clients that announce the size send exactly that many raw bytes, the others end with a marker
+    long total = expected >= 0 ? receive_file_data(conn, fd, expected, filename) : receive_legacy_data(conn, fd, filename);
+    int complete = total >= 0 && (expected < 0 || total == expected);
+
+    // One flush to disk for the whole file instead of one per chunk
+    if (complete && fdatasync(fd) != 0)
+    {
+        perror("fdatasync");
+        complete = 0;
+    }
+    close(fd);
+
+    if (total > 0)
+        atomic_fetch_add(&server_stats.transfer_bytes_received, total);
+
+    if (!complete)
+    {
+        printf("Upload de '%s' incomplet: %ld/%ld octets\n", filename, total, expected);
+        unlink(filepath);
+        snprintf(response, size, "Erreur serveur: transfert incomplet.\n");
+        return -1;
+    }
+    printf("Fichier reçu et sauvegardé: %s (%ld octets)\n", filepath, total);
+    snprintf(response, size, "Fichier reçu avec succès\n");
+    return 0;
+}
+
+int receive_upload(Connection *conn, const char *argument)
 {
+    char filename[256] = {0};
+    char response[256];
+    long expected = -1;
+
+    if (sscanf(argument, "%255s %ld", filename, &expected) < 1 || strstr(filename, "..") != NULL)
+    {
+        transfer_reply(conn, "Nom de fichier invalide.\n", 26);
+        return -1;
+    }
+
+    int result = store_upload(conn, filename, expected, response, sizeof(response));
+    transfer_reply(conn, response, strlen(response));
+    return result;
+}
+
+long send_file_data(int socketFd, int file, long file_size, const char *filename)
+{
+    struct timespec last;
+    off_t offset = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &last);
+
+    // The kernel copies from the page cache to the socket
+    while (offset < file_size)
+    {
+        size_t chunk = file_size - offset < SENDFILE_CHUNK ? (size_t)(file_size - offset) : SENDFILE_CHUNK;
+        ssize_t bytes_sent = sendfile(socketFd, file, &offset, chunk);
+
+        if (bytes_sent < 0 && errno == EINTR)
+            continue;
+        if (bytes_sent <= 0)
+        {
+            printf("Erreur d'envoi de '%s': %s\n", filename, bytes_sent < 0 ? strerror(errno) : "fin de fichier");
+            break;
+        }
+
+        transfer_progress("Envoi", filename, (long)offset, file_size, &last);
+    }
+    atomic_fetch_add(&server_stats.transfer_bytes_sent, offset);
+    return (long)offset;
+}
+
+int send_download(Connection *conn, const char *input)
+{
+    int socketFd = conn->fd;
+    int result = -1;
     char filename[256] = {0};
     char filepath[512] = {0};
     char response[1024] = {0};
@@ -209,254 +488,349 @@ void download(int socketFd, const char *input)
     if (sscanf(input + 10, "%255s", filename) != 1)
     {
         strcpy(response, "Erreur: Format incorrect. Utilisation: @download nom_fichier\n");
-        send(socketFd, response, strlen(response), 0);
-        return;
+        transfer_reply(conn, response, strlen(response));
+        return -1;
     }
 
     snprintf(filepath, sizeof(filepath), "uploads/%s", filename);
-    FILE *file = fopen(filepath, "rb");
 
-    if (!file)
+    // A single descriptor gives both the size and the data
+    int file = open(filepath, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if (file < 0 || fstat(file, &st) != 0 || !S_ISREG(st.st_mode))
     {
+        if (file >= 0)
+            close(file);
         sprintf(response, "Erreur: Le fichier '%s' n'existe pas dans le répertoire uploads.\n", filename);
-        send(socketFd, response, strlen(response), 0);
-        return;
+        transfer_reply(conn, response, strlen(response));
+        return -1;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    fclose(file);
+    long file_size = (long)st.st_size;
     sprintf(response, "READY_TO_SEND:%s:%ld", filename, file_size);
     printf("Envoi de la réponse: %s\n", response);
-    send(socketFd, response, strlen(response), 0);
+    transfer_reply(conn, response, strlen(response));
 
     char confirm[32] = {0};
-    int confirm_recv = recv(socketFd, confirm, sizeof(confirm), 0);
+    int confirm_recv = transfer_read_message(conn, confirm, sizeof(confirm));
 
     if (confirm_recv <= 0)
     {
         printf("Erreur: Pas de confirmation du client\n");
-        return;
+        close(file);
+        return -1;
     }
     if (strcmp(confirm, "READY") == 0)
     {
-        FILE *f = fopen(filepath, "rb");
+        long sent = send_file_data(socketFd, file, file_size, filename);
 
-        if (!f)
-        {
-            strcpy(response, "Erreur: Impossible d'ouvrir le fichier pour l'envoi.\n");
-            send(socketFd, response, strlen(response), 0);
-            return;
-        }
-
-        char buffer[1024];
-        size_t bytes_read;
-        long sent = 0;
-
-        while ((bytes_read = fread(buffer, 1, sizeof(buffer), f)) > 0)
-        {
-            int bytes_sent = send(socketFd, buffer, bytes_read, 0);
-            if (bytes_sent <= 0)
-            {
-                printf("Erreur d'envoi: %d\n", bytes_sent);
-                break;
-            }
-            sent += bytes_sent;
-            printf("\rEnvoi: %ld/%ld octets (%.1f%%)", sent, file_size, (float)sent / file_size * 100);
-            fflush(stdout);
-        }
-
-        fclose(f);
         send(socketFd, "__END__", 7, 0);
 
         if (sent == file_size)
         {
             sprintf(response, "Fichier '%s' (%ld octets) envoyé avec succès.\n", filename, file_size);
+            result = 0;
         }
         else
         {
             sprintf(response, "Erreur: Transfert incomplet. Envoyé %ld/%ld octets.\n", sent, file_size);
         }
-        send(socketFd, response, strlen(response), 0);
+        transfer_reply(conn, response, strlen(response));
     }
     else
     {
         strcpy(response, "Erreur: Le client n'est pas prêt à recevoir le fichier.\n");
-        send(socketFd, response, strlen(response), 0);
+        transfer_reply(conn, response, strlen(response));
     }
+    close(file);
+    return result;
 }
 
-void handle_login(int client_socket)
+int serve_download(Connection *conn, const TransferOffer *offer, char *response, size_t size)
 {
-    char buffer[200];
-    char username[100];
-    char password[100];
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "uploads/%s", offer->filename);
 
-    getpeername(client_socket, (struct sockaddr *)&addr, &len);
-    send(client_socket, "Entrez votre pseudo: ", 22, 0);
+    int file = open(filepath, O_RDONLY | O_CLOEXEC);
+    struct stat st;
 
-    int rlen = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-    if (rlen <= 0)
-        return;
+    if (file < 0 || fstat(file, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        if (file >= 0)
+            close(file);
+        snprintf(response, size, "Erreur: Le fichier '%s' n'existe plus.\n", offer->filename);
+        return -1;
+    }
 
-    buffer[rlen] = '\0';
-    strncpy(username, buffer, sizeof(username));
-    username[sizeof(username) - 1] = '\0';
+    // The file may have changed since it was announced: the data connection gets the actual size first
+    long file_size = (long)st.st_size;
+    char header[32];
+    int length = snprintf(header, sizeof(header), "%ld", file_size);
+    long sent = -1;
 
-    send(client_socket, "Entrez votre mot de passe: ", 28, 0);
-    rlen = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+    if (frameSend(conn->fd, FRAME_TRANSFER, header, length) == 0)
+        sent = send_file_data(conn->fd, file, file_size, offer->filename);
+    close(file);
 
-    if (rlen <= 0)
-        return;
+    if (sent != file_size)
+    {
+        snprintf(response, size, "Erreur: Transfert incomplet. Envoyé %ld/%ld octets.\n", sent < 0 ? 0 : sent, file_size);
+        return -1;
+    }
+    snprintf(response, size, "Fichier '%s' (%ld octets) envoyé avec succès.\n", offer->filename, file_size);
+    return 0;
+}
 
-    buffer[rlen] = '\0';
-    strncpy(password, buffer, sizeof(password));
-    password[sizeof(password) - 1] = '\0';
+void count_transfer(int result)
+{
+    atomic_fetch_add(result == 0 ? &server_stats.transfers_completed : &server_stats.transfers_failed, 1);
+}
+
+void run_inband_transfer(void *arg)
+{
+    Transfer *transfer = (Transfer *)arg;
+
+    reactorDrain(transfer->conn);
+
+    if (transfer->is_upload)
+        count_transfer(receive_upload(transfer->conn, transfer->argument));
+    else
+        count_transfer(send_download(transfer->conn, transfer->argument));
 
-    User *user = findUserByName(username);
+    reactorResume(transfer->conn);
+    free(transfer);
+}
+
+void start_transfer(Connection *conn, int is_upload, const char *argument)
+{
+    Transfer *transfer = malloc(sizeof(Transfer));
 
-    if (!user)
+    if (transfer == NULL)
     {
-        registerUser(username, password, client_socket, addr);
+        perror("malloc transfer");
+        return;
     }
-    else if (strcmp(user->password, password) == 0)
+    transfer->conn = conn;
+    transfer->is_upload = is_upload;
+    strncpy(transfer->argument, argument, sizeof(transfer->argument) - 1);
+    transfer->argument[sizeof(transfer->argument) - 1] = '\0';
+
+    // Legacy clients transfer on their chat connection: the reactor stops watching it until a worker
+    // is done, and pending output is written before the transfer starts
+    reactorSuspend(conn);
+
+    if (transferPoolSubmit(run_inband_transfer, transfer) != 0)
     {
-        pthread_mutex_lock(&users_mutex);
-        user->authenticated = true;
-        user->socket_fd = client_socket;
-        pthread_mutex_unlock(&users_mutex);
-        send(client_socket, "Connexion réussie.\n", 20, 0);
+        free(transfer);
+        reactorResume(conn);
+        send_client_data(conn->fd, "Erreur: trop de transferts en cours, réessayez plus tard.\n", 60);
     }
-    else
+}
+
+void offer_transfer(Connection *conn, int is_upload, const char *filename, long size)
+{
+    TransferOffer offer = {0};
+    char response[512];
+
+    offer.owner_fd = conn->fd;
+    snprintf(offer.owner, sizeof(offer.owner), "%s", conn->username);
+    offer.is_upload = is_upload;
+    snprintf(offer.filename, sizeof(offer.filename), "%s", filename);
+    offer.size = size;
+
+    if (transferOffer(&offer) != 0)
     {
-        send(client_socket, "Mot de passe incorrect.\n", 25, 0);
+        send_client_data(conn->fd, "Erreur: trop de transferts en cours, réessayez plus tard.\n", 60);
+        return;
     }
+    snprintf(response, sizeof(response), "TRANSFER:%s:%s:%s:%ld", offer.token, is_upload ? "upload" : "download", filename, size);
+    send_client_data(conn->fd, response, strlen(response));
+}
+
+void run_data_transfer(void *arg)
+{
+    DataTransfer *transfer = (DataTransfer *)arg;
+    Connection *conn = transfer->conn;
+    TransferOffer *offer = &transfer->offer;
+    char response[512];
+    int result;
+
+    reactorDrain(conn);
+
+    if (offer->is_upload)
+        result = store_upload(conn, offer->filename, offer->size, response, sizeof(response));
+    else
+        result = serve_download(conn, offer, response, sizeof(response));
+
+    count_transfer(result);
+    notify_owner(offer, response);
+
+    // The data connection is done: the reactor closes it when it sees the shutdown
+    shutdown(conn->fd, SHUT_RDWR);
+    reactorResume(conn);
+    free(transfer);
 }
 
-int main()
+void handle_transfer(Connection *conn, const char *token)
 {
-    int server_socket = socket(PF_INET, SOCK_STREAM, 0);
-    loadUsersFromJson("users.json");
+    DataTransfer *transfer = malloc(sizeof(DataTransfer));
 
-    if (server_socket == -1)
+    if (transfer == NULL || conn->state != CONN_WAIT_USERNAME || transferClaim(token, &transfer->offer) != 0)
     {
-        perror("socket");
-        exit(1);
+        printf("Client %d: jeton de transfert invalide\n", conn->fd);
+        free(transfer);
+        shutdown(conn->fd, SHUT_RDWR);
+        return;
     }
-    int opt = 1;
-    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    transfer->conn = conn;
+    printf("Client %d: connexion de données pour '%s' (%s)\n", conn->fd, transfer->offer.filename, transfer->offer.owner);
+
+    reactorSuspend(conn);
+
+    if (transferPoolSubmit(run_data_transfer, transfer) != 0)
     {
-        perror("setsockopt");
-        exit(1);
+        notify_owner(&transfer->offer, "Erreur: trop de transferts en cours, réessayez plus tard.\n");
+        shutdown(conn->fd, SHUT_RDWR);
+        reactorResume(conn);
+        free(transfer);
     }
+}
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons((short)31473);
+void upload(int socketFd, const char *argument)
+{
+    Connection *conn = reactorGetConnection(socketFd);
 
-    int res = bind(server_socket, (struct sockaddr *)&addr, sizeof(addr));
+    if (conn == NULL)
+        return;
 
-    if (res == -1)
+    if (conn->protocol != PROTOCOL_V2)
     {
-        perror("bind");
-        exit(1);
+        start_transfer(conn, 1, argument);
+        return;
     }
 
-    res = listen(server_socket, 5);
+    // v2 clients send the data on a connection of their own, the chat connection stays free
+    char filename[256] = {0};
+    long size = -1;
 
-    if (res == -1)
+    if (sscanf(argument, "%255s %ld", filename, &size) != 2 || size < 0)
     {
-        perror("listen");
-        exit(1);
+        send_client_data(socketFd, "Taille du fichier manquante.\n", 30);
+        return;
     }
+    offer_transfer(conn, 1, filename, size);
+}
+
+void download(int socketFd, const char *input)
+{
+    Connection *conn = reactorGetConnection(socketFd);
 
-    client_sockets = (List *)malloc(sizeof(List));
+    if (conn == NULL)
+        return;
 
-    if (client_sockets == NULL)
+    if (conn->protocol != PROTOCOL_V2)
     {
-        perror("malloc client_sockets");
-        exit(1);
+        start_transfer(conn, 0, input);
+        return;
     }
 
-    client_sockets->first = NULL;
-    client_sockets->curr = NULL;
-    client_sockets->size = 0;
-    printf("Serveur démarré sur le port 31473\n");
+    char filename[256] = {0};
+    char filepath[512];
+    struct stat st;
 
-    shouldShutdown = malloc(sizeof(int));
-    if (shouldShutdown == NULL)
+    if (sscanf(input + 10, "%255s", filename) != 1 || strstr(filename, "..") != NULL)
     {
-        perror("malloc shouldShutdown");
-        free(client_sockets);
-        exit(1);
+        send_client_data(socketFd, "Erreur: Format incorrect. Utilisation: @download nom_fichier\n", 62);
+        return;
     }
-    *shouldShutdown = 0;
+    snprintf(filepath, sizeof(filepath), "uploads/%s", filename);
 
-    while (!*shouldShutdown)
+    if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode))
     {
-        fd_set readfds;
-        struct timeval timeout;
-        FD_ZERO(&readfds);
-        FD_SET(server_socket, &readfds);
-        timeout.tv_sec = 1; // Verify every second
-        timeout.tv_usec = 0;
+        char response[512];
+        snprintf(response, sizeof(response), "Erreur: Le fichier '%s' n'existe pas dans le répertoire uploads.\n", filename);
+        send_client_data(socketFd, response, strlen(response));
+        return;
+    }
+    offer_transfer(conn, 0, filename, (long)st.st_size);
+}
 
-        int activity = select(server_socket + 1, &readfds, NULL, NULL, &timeout);
+void handle_login(Connection *conn, const char *input)
+{
+    int client_socket = conn->fd;
 
-        if (activity < 0)
-        {
-            perror("select");
-            continue;
-        }
+    if (conn->state == CONN_WAIT_USERNAME)
+    {
+        strncpy(conn->username, input, sizeof(conn->username));
+        conn->username[sizeof(conn->username) - 1] = '\0';
+        conn->state = CONN_WAIT_PASSWORD;
+        send_client_data(client_socket, "Entrez votre mot de passe: ", 28);
+        return;
+    }
 
-        if (activity == 0)
-            continue;
+    char password[100];
+    strncpy(password, input, sizeof(password));
+    password[sizeof(password) - 1] = '\0';
+    conn->state = CONN_READY;
 
-        if (FD_ISSET(server_socket, &readfds))
-        {
-            struct sockaddr_in client_addr;
-            socklen_t addrlen = sizeof(client_addr);
-            int new_socket = accept(server_socket, (struct sockaddr *)&client_addr, &addrlen);
+    int status = loginUser(conn->username, password, client_socket);
 
-            if (new_socket < 0)
-            {
-                perror("accept");
-                continue;
-            }
+    if (status == -1)
+    {
+        registerUser(conn->username, password, client_socket);
+    }
+    else if (status == 0)
+    {
+        send_client_data(client_socket, "Connexion réussie.\n", 20);
+    }
+    else
+    {
+        send_client_data(client_socket, "Mot de passe incorrect.\n", 25);
+    }
 
-            printf("Nouveau client connecté (socket: %d)\n", new_socket);
-            add_client(new_socket);
+    // Joined once the answer is queued: the backlog of the channel follows it
+    channelJoin(channelFind(CHANNEL_GENERAL), client_socket);
+}
 
-            int *arg = malloc(sizeof(int));
+int main(int argc, char **argv)
+{
+    if (parseConfig(argc, argv) != 0)
+        exit(1);
 
-            if (arg == NULL)
-            {
-                perror("malloc");
-                remove_client(new_socket);
-                continue;
-            }
+    // A client that disconnects must not kill the server with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
 
-            *arg = new_socket;
-            pthread_t thread_id;
+    arenaInstallJsonHooks();
+    if (loadUsers() != 0 || openUserLog() != 0)
+        exit(1);
 
-            if (pthread_create(&thread_id, NULL, handle_client, arg) != 0)
-            {
-                perror("pthread_create");
-                free(arg);
-                remove_client(new_socket);
-                continue;
-            }
-            pthread_detach(thread_id);
-        }
+    int max_fds = reactorRaiseFileLimit();
+
+    if (transferPoolStart() != 0 || sessionInit(max_fds) != 0 || channelInit(max_fds) != 0)
+        exit(1);
+    if (server_config.msglog_directory != NULL && msglogOpen(server_config.msglog_directory) != 0)
+        exit(1);
+
+    shouldShutdown = malloc(sizeof(int));
+    if (shouldShutdown == NULL)
+    {
+        perror("malloc shouldShutdown");
+        exit(1);
     }
-    pthread_mutex_lock(&clients_mutex);
-    pthread_mutex_unlock(&clients_mutex);
-    free(client_sockets);
-    close(server_socket);
-    pthread_mutex_destroy(&clients_mutex);
+    *shouldShutdown = 0;
+
+    if (reactorStartAll(shouldShutdown) == -1)
+    {
+        reactorJoinAll();
+        free(shouldShutdown);
+        exit(1);
+    }
+    printf("Serveur démarré sur le port %d (%d reactor(s))\n", SERVER_PORT, reactorCount());
+
+    reactorJoinAll();
+    msglogClose();
+    closeUserLog();
+    free(shouldShutdown);
     return 0;
 }
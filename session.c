@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "session.h"
+#include "epoch.h"
+
+static Session *sessions = NULL;
+static int sessions_capacity = 0;
+
+// Sessions ouvertes et sessions de chaque rôle, un bit par socket, pour calculer des audiences
+static Bitset online;
+static Bitset roles[SESSION_ROLE_COUNT];
+// Au-delà du plus grand socket ouvert plus un, aucun bit n'a jamais été posé
+static atomic_int high_water = 0;
+
+/**
+ ** Allocates the session table and the session sets, one entry per possible file descriptor.
+ * @param capacity (int) - The number of file descriptors the process may open.
+ * @returns int - 0 on success, -1 on error.
+ */
+int sessionInit(int capacity)
+{
+    sessions = calloc(capacity, sizeof(Session));
+
+    if (sessions == NULL || bitsetInit(&online, (size_t)capacity) == -1)
+    {
+        perror("calloc sessions");
+        return -1;
+    }
+    for (int i = 0; i < SESSION_ROLE_COUNT; i++)
+    {
+        if (bitsetInit(&roles[i], (size_t)capacity) == -1)
+        {
+            perror("calloc sessions");
+            return -1;
+        }
+    }
+    sessions_capacity = capacity;
+    return 0;
+}
+
+/**
+ ** Records the role of a session in the role sets, out of the one of a previous login on the socket.
+ * @param fd (int) - The client socket.
+ * @param role (Role) - The role of the user logged in on it.
+ * @returns void
+ */
+static void setSessionRole(int fd, Role role)
+{
+    for (int i = 0; i < SESSION_ROLE_COUNT; i++)
+    {
+        if (i != (int)role)
+            bitsetClear(&roles[i], (size_t)fd);
+    }
+    bitsetSet(&roles[role], (size_t)fd);
+}
+
+/**
+ ** Marks a user as no longer connected on a socket, unless they logged in elsewhere since.
+ * @param entry (RegistryEntry*) - The registry entry of the user, or NULL.
+ * @param fd (int) - The socket.
+ * @returns void
+ */
+static void leaveEntry(RegistryEntry *entry, int fd)
+{
+    if (entry != NULL)
+        atomic_compare_exchange_strong(&entry->socket_fd, &fd, -1);
+}
+
+/**
+ ** Binds a socket to the user that just logged in on it, and records the socket in the user's registry entry.
+ * @param fd (int) - The client socket.
+ * @param entry (RegistryEntry*) - The registry entry of the authenticated user.
+ * @returns void
+ */
+void sessionOpen(int fd, RegistryEntry *entry)
+{
+    if (fd < 0 || fd >= sessions_capacity)
+        return;
+
+    Session *session = &sessions[fd];
+    Role role;
+
+    epochEnter();
+    role = atomic_load(&entry->user)->role;
+    epochExit();
+    atomic_store(&session->role, role);
+    setSessionRole(fd, role);
+    atomic_store(&session->authenticated, true);
+    atomic_store(&session->commands, 0);
+    atomic_store(&session->messages, 0);
+    session->login_time = time(NULL);
+    atomic_store(&entry->socket_fd, fd);
+
+    RegistryEntry *previous = atomic_exchange_explicit(&session->entry, entry, memory_order_acq_rel);
+    int high = atomic_load(&high_water);
+
+    // Raised before the bit is set: a reader bounded by it sees every session it would see otherwise
+    while (fd >= high && !atomic_compare_exchange_weak(&high_water, &high, fd + 1))
+        ;
+    bitsetSet(&online, (size_t)fd);
+
+    // Logging in as someone else on the same socket disconnects the previous user
+    if (previous != entry)
+        leaveEntry(previous, fd);
+}
+
+/**
+ ** Forgets the session of a socket that is being closed.
+ * @param fd (int) - The client socket.
+ * @returns void
+ */
+void sessionClose(int fd)
+{
+    if (fd < 0 || fd >= sessions_capacity)
+        return;
+
+    bitsetClear(&online, (size_t)fd);
+    for (int i = 0; i < SESSION_ROLE_COUNT; i++)
+        bitsetClear(&roles[i], (size_t)fd);
+    leaveEntry(atomic_exchange_explicit(&sessions[fd].entry, NULL, memory_order_acq_rel), fd);
+    atomic_store(&sessions[fd].authenticated, false);
+}
+
+/**
+ ** Returns the session of a socket. Lock-free: one array access.
+ * @param fd (int) - The client socket.
+ * @returns Session* - The session, or NULL if no user is logged in on this socket.
+ */
+Session *sessionGet(int fd)
+{
+    if (fd < 0 || fd >= sessions_capacity)
+        return NULL;
+
+    Session *session = &sessions[fd];
+
+    if (atomic_load_explicit(&session->entry, memory_order_acquire) == NULL)
+        return NULL;
+    return session;
+}
+
+/**
+ ** Returns the registry entry of the user logged in on a socket.
+ * @param fd (int) - The client socket.
+ * @returns RegistryEntry* - The entry, or NULL if nobody is logged in.
+ */
+RegistryEntry *sessionEntry(int fd)
+{
+    if (fd < 0 || fd >= sessions_capacity)
+        return NULL;
+    return atomic_load_explicit(&sessions[fd].entry, memory_order_acquire);
+}
+
+/**
+ ** Tells whether an administrator is logged in on a socket.
+ * @param fd (int) - The client socket.
+ * @returns int - 1 for an administrator, 0 otherwise.
+ */
+int sessionIsAdmin(int fd)
+{
+    Session *session = sessionGet(fd);
+
+    return session != NULL && atomic_load(&session->role) == ADMIN;
+}
+
+/**
+ ** Returns the set of the sockets a user is logged in on. Lock-free: it may be read while sessions open and close.
+ * @returns const Bitset* - The set, sized for every possible file descriptor.
+ */
+const Bitset *sessionOnline(void)
+{
+    return &online;
+}
+
+/**
+ ** Returns the number of sockets the session sets may hold a bit for: the highest socket a user
+ * ever logged in on, plus one. It never decreases; the kernel reuses the lowest free descriptors.
+ * @returns size_t - The bound, to pass to bitsetPrefix.
+ */
+size_t sessionHighWater(void)
+{
+    return (size_t)atomic_load(&high_water);
+}
+
+/**
+ ** Returns the set of the sockets a user of a given role is logged in on.
+ * @param role (Role) - The role.
+ * @returns const Bitset* - The set, sized like sessionOnline().
+ */
+const Bitset *sessionRole(Role role)
+{
+    return &roles[role];
+}
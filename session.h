@@ -0,0 +1,34 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdatomic.h>
+#include <time.h>
+#include "registry.h"
+#include "bitset.h"
+
+// Session d'un client connecté, rangée à l'indice de son socket.
+// entry est publiée en dernier: un lecteur qui la voit non NULL voit aussi le reste de la session.
+typedef struct session
+{
+    _Atomic(RegistryEntry *) entry;
+    atomic_int role;
+    atomic_bool authenticated;
+    atomic_ulong commands;
+    atomic_ulong messages;
+    time_t login_time;
+} Session;
+
+// Rôles distingués par un ensemble de sessions (voir sessionRole)
+#define SESSION_ROLE_COUNT (ADMIN + 1)
+
+int sessionInit(int capacity);
+void sessionOpen(int fd, RegistryEntry *entry);
+void sessionClose(int fd);
+Session *sessionGet(int fd);
+RegistryEntry *sessionEntry(int fd);
+int sessionIsAdmin(int fd);
+const Bitset *sessionOnline(void);
+size_t sessionHighWater(void);
+const Bitset *sessionRole(Role role);
+
+#endif
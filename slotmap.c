@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include "slotmap.h"
+
+#define SLOT_MAP_MIN_CAPACITY 64
+#define SLOT_NONE UINT32_MAX
+
+/**
+ ** Initializes an empty slot map.
+ * @param map (SlotMap*) - The slot map.
+ * @returns void
+ */
+void slotMapInit(SlotMap *map)
+{
+    memset(map, 0, sizeof(SlotMap));
+    map->free_slot = SLOT_NONE;
+}
+
+/**
+ ** Releases the storage of a slot map.
+ * @param map (SlotMap*) - The slot map.
+ * @returns void
+ */
+void slotMapFree(SlotMap *map)
+{
+    free(map->values);
+    free(map->value_slots);
+    free(map->slots);
+    slotMapInit(map);
+}
+
+/**
+ ** Doubles the capacity of a slot map.
+ * @param map (SlotMap*) - The slot map.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+static int slotMapGrow(SlotMap *map)
+{
+    size_t capacity = map->capacity == 0 ? SLOT_MAP_MIN_CAPACITY : map->capacity * 2;
+
+    if (capacity >= SLOT_NONE)
+        return -1;
+
+    int *values = realloc(map->values, capacity * sizeof(int));
+    if (values == NULL)
+        return -1;
+    map->values = values;
+
+    uint32_t *value_slots = realloc(map->value_slots, capacity * sizeof(uint32_t));
+    if (value_slots == NULL)
+        return -1;
+    map->value_slots = value_slots;
+
+    Slot *slots = realloc(map->slots, capacity * sizeof(Slot));
+    if (slots == NULL)
+        return -1;
+    map->slots = slots;
+
+    map->capacity = capacity;
+    return 0;
+}
+
+/**
+ ** Adds a value at the end of the dense array.
+ * @param map (SlotMap*) - The slot map.
+ * @param value (int) - The value to add.
+ * @returns SlotHandle - The handle of the value, or SLOT_HANDLE_INVALID if memory is exhausted.
+ */
+SlotHandle slotMapInsert(SlotMap *map, int value)
+{
+    if (map->count == map->capacity && slotMapGrow(map) != 0)
+        return SLOT_HANDLE_INVALID;
+
+    uint32_t slot_index;
+
+    // A free slot is reused first; there are never more slots than values the map can hold
+    if (map->free_slot != SLOT_NONE)
+    {
+        slot_index = map->free_slot;
+        map->free_slot = map->slots[slot_index].index;
+    }
+    else
+    {
+        slot_index = (uint32_t)map->slot_count++;
+        map->slots[slot_index].generation = 1;
+    }
+
+    Slot *slot = &map->slots[slot_index];
+    slot->index = (uint32_t)map->count;
+    map->values[map->count] = value;
+    map->value_slots[map->count] = slot_index;
+    map->count++;
+
+    return ((SlotHandle)slot->generation << 32) | slot_index;
+}
+
+/**
+ ** Finds the slot of a handle if the handle is still valid.
+ * @param map (SlotMap*) - The slot map.
+ * @param handle (SlotHandle) - The handle.
+ * @returns Slot* - The slot, or NULL for a stale or invalid handle.
+ */
+static Slot *slotMapResolve(SlotMap *map, SlotHandle handle)
+{
+    uint32_t slot_index = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32);
+
+    if (slot_index >= map->slot_count || map->slots[slot_index].generation != generation)
+        return NULL;
+    return &map->slots[slot_index];
+}
+
+/**
+ ** Removes a value. The last value moves into its place, so the array stays dense.
+ * @param map (SlotMap*) - The slot map.
+ * @param handle (SlotHandle) - The handle of the value.
+ * @returns int - 0 on success, -1 if the handle is stale.
+ */
+int slotMapRemove(SlotMap *map, SlotHandle handle)
+{
+    Slot *slot = slotMapResolve(map, handle);
+
+    if (slot == NULL)
+        return -1;
+
+    uint32_t hole = slot->index;
+    uint32_t last = (uint32_t)(map->count - 1);
+
+    map->values[hole] = map->values[last];
+    map->value_slots[hole] = map->value_slots[last];
+    map->slots[map->value_slots[hole]].index = hole;
+    map->count--;
+
+    // A new generation makes every copy of the handle stale; generation 0 is never used
+    slot->generation++;
+    if (slot->generation == 0)
+        slot->generation = 1;
+    slot->index = map->free_slot;
+    map->free_slot = (uint32_t)handle;
+    return 0;
+}
+
+/**
+ ** Returns the value of a handle.
+ * @param map (SlotMap*) - The slot map.
+ * @param handle (SlotHandle) - The handle.
+ * @returns int* - The value, or NULL if the handle is stale.
+ */
+int *slotMapGet(SlotMap *map, SlotHandle handle)
+{
+    Slot *slot = slotMapResolve(map, handle);
+
+    if (slot == NULL)
+        return NULL;
+    return &map->values[slot->index];
+}
@@ -0,0 +1,41 @@
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Poignée sur une valeur: génération (32 bits hauts) et numéro de case (32 bits bas).
+// Une poignée dont la valeur a été retirée devient invalide, même si la case est réutilisée.
+typedef uint64_t SlotHandle;
+
+#define SLOT_HANDLE_INVALID 0
+
+typedef struct slot
+{
+    uint32_t generation;
+    uint32_t index;
+} Slot;
+
+/*
+ * Tableau dense de valeurs avec insertion et suppression en O(1), sans allocation par élément.
+ * Les valeurs restent contiguës (values[0..count-1]) pour les parcours: une suppression
+ * déplace la dernière valeur dans le trou. Les cases libres sont chaînées par leur champ index.
+ */
+typedef struct slot_map
+{
+    int *values;
+    uint32_t *value_slots;
+    Slot *slots;
+    size_t count;
+    size_t capacity;
+    size_t slot_count;
+    uint32_t free_slot;
+} SlotMap;
+
+void slotMapInit(SlotMap *map);
+void slotMapFree(SlotMap *map);
+SlotHandle slotMapInsert(SlotMap *map, int value);
+int slotMapRemove(SlotMap *map, SlotHandle handle);
+int *slotMapGet(SlotMap *map, SlotHandle handle);
+
+#endif
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "registry.h"
+
+/**
+ ** Maps a snapshot file and checks its layout. No record is read.
+ * @param snapshot (Snapshot*) - Receives the mapping.
+ * @param path (const char*) - The snapshot file.
+ * @returns int - 0 on success, 1 if the file does not exist, -1 if it is invalid.
+ */
+int snapshotOpen(Snapshot *snapshot, const char *path)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+    {
+        if (errno == ENOENT)
+            return 1;
+        perror("open instantané");
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror("mmap instantané");
+        return -1;
+    }
+
+    const SnapshotHeader *header = base;
+    uint64_t size = (uint64_t)st.st_size;
+    // Only the header is checked, so that startup does not depend on the number of users: a slot and
+    // its record are checked by the lookup that reaches them (snapshotFind)
+    int valid = header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION &&
+                header->index_capacity >= SNAPSHOT_MIN_CAPACITY && (header->index_capacity & (header->index_capacity - 1)) == 0 &&
+                header->index_capacity <= size / sizeof(SnapshotSlot) &&
+                header->record_count * 2 <= header->index_capacity &&
+                header->records_offset >= sizeof(SnapshotHeader) && header->records_offset <= size &&
+                header->records_offset + header->record_count * sizeof(SnapshotRecord) <= header->index_offset &&
+                header->index_offset <= size &&
+                header->index_offset + header->index_capacity * sizeof(SnapshotSlot) <= size;
+
+    if (!valid)
+    {
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    // Lookups jump around the index: reading ahead would only load pages nobody asked for
+    madvise(base, st.st_size, MADV_RANDOM);
+
+    snapshot->base = base;
+    snapshot->size = st.st_size;
+    snapshot->header = header;
+    snapshot->records = (const SnapshotRecord *)((const char *)base + header->records_offset);
+    snapshot->index = (const SnapshotSlot *)((const char *)base + header->index_offset);
+    return 0;
+}
+
+/**
+ ** Finds a user in a snapshot.
+ * @param snapshot (const Snapshot*) - The snapshot; may be closed, i.e. empty.
+ * @param name (const char*) - The username.
+ * @returns const SnapshotRecord* - The record, or NULL if the snapshot does not hold the user.
+ */
+const SnapshotRecord *snapshotFind(const Snapshot *snapshot, const char *name)
+{
+    if (snapshot->base == NULL)
+        return NULL;
+
+    uint64_t hash = registryHash(name);
+    size_t mask = snapshot->header->index_capacity - 1;
+    size_t i = hash & mask;
+
+    // The probe never visits a slot twice, even in an index with no empty slot
+    for (size_t probes = 0; probes < snapshot->header->index_capacity; probes++, i = (i + 1) & mask)
+    {
+        const SnapshotSlot *slot = &snapshot->index[i];
+
+        // A record number out of range means a damaged file: treat it as the end of the probe
+        if (slot->record == 0 || slot->record > snapshot->header->record_count)
+            return NULL;
+
+        const SnapshotRecord *record = &snapshot->records[slot->record - 1];
+
+        if (slot->hash == (uint32_t)hash && strncmp(record->name, name, sizeof(record->name)) == 0)
+            return record;
+    }
+    return NULL;
+}
+
+/**
+ ** Returns the number of users in a snapshot.
+ * @param snapshot (const Snapshot*) - The snapshot.
+ * @returns size_t - The number of users.
+ */
+size_t snapshotCount(const Snapshot *snapshot)
+{
+    return snapshot->base != NULL ? snapshot->header->record_count : 0;
+}
+
+/**
+ ** Copies a snapshot record into a user.
+ * @param record (const SnapshotRecord*) - The record.
+ * @param user (User*) - Receives the user; its strings are always terminated.
+ * @returns void
+ */
+void snapshotToUser(const SnapshotRecord *record, User *user)
+{
+    memset(user, 0, sizeof(*user));
+    memcpy(user->name, record->name, sizeof(user->name) - 1);
+    memcpy(user->password, record->password, sizeof(user->password) - 1);
+    user->role = record->role == ADMIN ? ADMIN : USER;
+}
+
+/**
+ ** Unmaps a snapshot.
+ * @param snapshot (Snapshot*) - The snapshot.
+ * @returns void
+ */
+void snapshotClose(Snapshot *snapshot)
+{
+    if (snapshot->base != NULL)
+        munmap(snapshot->base, snapshot->size);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+/**
+ ** Starts writing a snapshot to a temporary file, renamed over the target on commit.
+ * @param writer (SnapshotWriter*) - The writer.
+ * @param path (const char*) - The snapshot file.
+ * @returns int - 0 on success, -1 on error.
+ */
+int snapshotWriterOpen(SnapshotWriter *writer, const char *path)
+{
+    memset(writer, 0, sizeof(*writer));
+    snprintf(writer->path, sizeof(writer->path), "%s", path);
+    snprintf(writer->temporary, sizeof(writer->temporary), "%s.tmp", path);
+
+    writer->file = fopen(writer->temporary, "w");
+    if (writer->file == NULL)
+    {
+        perror("fopen instantané");
+        return -1;
+    }
+
+    // Records come first; the header is written last, once the index is known
+    SnapshotHeader header = {0};
+
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1)
+    {
+        snapshotWriterAbort(writer);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ ** Appends a user to the snapshot being written.
+ * @param writer (SnapshotWriter*) - The writer.
+ * @param user (const User*) - The user.
+ * @returns int - 0 on success, -1 on error.
+ */
+int snapshotWriterAdd(SnapshotWriter *writer, const User *user)
+{
+    if (writer->count == writer->capacity)
+    {
+        size_t capacity = writer->capacity == 0 ? 1024 : writer->capacity * 2;
+        uint64_t *hashes = realloc(writer->hashes, capacity * sizeof(uint64_t));
+
+        if (hashes == NULL)
+            return -1;
+        writer->hashes = hashes;
+        writer->capacity = capacity;
+    }
+
+    SnapshotRecord record = {0};
+
+    snprintf(record.name, sizeof(record.name), "%s", user->name);
+    snprintf(record.password, sizeof(record.password), "%s", user->password);
+    record.role = (uint8_t)user->role;
+
+    if (fwrite(&record, sizeof(record), 1, writer->file) != 1)
+        return -1;
+    writer->hashes[writer->count++] = registryHash(user->name);
+    return 0;
+}
+
+/**
+ ** Writes the index and the header, then replaces the snapshot file. The new file is durable on success.
+ * The writer is released in every case.
+ * @param writer (SnapshotWriter*) - The writer.
+ * @returns int - 0 on success, -1 on error.
+ */
+int snapshotWriterCommit(SnapshotWriter *writer)
+{
+    SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, writer->count, sizeof(SnapshotHeader), SNAPSHOT_MIN_CAPACITY, 0};
+
+    while (header.index_capacity < writer->count * 2)
+        header.index_capacity *= 2;
+    header.index_offset = header.records_offset + writer->count * sizeof(SnapshotRecord);
+
+    SnapshotSlot *index = calloc(header.index_capacity, sizeof(SnapshotSlot));
+    size_t mask = header.index_capacity - 1;
+
+    if (index == NULL)
+    {
+        snapshotWriterAbort(writer);
+        return -1;
+    }
+    for (size_t r = 0; r < writer->count; r++)
+    {
+        size_t i = writer->hashes[r] & mask;
+
+        while (index[i].record != 0)
+            i = (i + 1) & mask;
+        index[i].record = (uint32_t)(r + 1);
+        index[i].hash = (uint32_t)writer->hashes[r];
+    }
+
+    int written = fwrite(index, sizeof(SnapshotSlot), header.index_capacity, writer->file) == header.index_capacity &&
+                  fseek(writer->file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, writer->file) == 1 &&
+                  fflush(writer->file) == 0 && fsync(fileno(writer->file)) == 0;
+
+    free(index);
+    if (fclose(writer->file) != 0 || !written || rename(writer->temporary, writer->path) != 0)
+    {
+        perror("écriture instantané");
+        writer->file = NULL;
+        snapshotWriterAbort(writer);
+        return -1;
+    }
+    writer->file = NULL;
+    free(writer->hashes);
+    writer->hashes = NULL;
+
+    int directory = open(".", O_RDONLY | O_DIRECTORY);
+
+    if (directory != -1)
+    {
+        fsync(directory);
+        close(directory);
+    }
+    return 0;
+}
+
+/**
+ ** Gives up a snapshot being written; the current snapshot file is left untouched.
+ * @param writer (SnapshotWriter*) - The writer.
+ * @returns void
+ */
+void snapshotWriterAbort(SnapshotWriter *writer)
+{
+    if (writer->file != NULL)
+        fclose(writer->file);
+    unlink(writer->temporary);
+    free(writer->hashes);
+    writer->file = NULL;
+    writer->hashes = NULL;
+}
@@ -0,0 +1,74 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "user.h"
+
+#define SNAPSHOT_MAGIC 0x504E5355u /* "USNP" */
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MIN_CAPACITY 64
+
+/*
+ * Instantané binaire des comptes, projeté en mémoire (mmap) au démarrage:
+ *   en-tête | enregistrements de taille fixe | index à adressage ouvert
+ * L'index est une table à sondage linéaire sur le hash FNV-1a du pseudo (registryHash),
+ * au plus à moitié pleine. Rien n'est lu au démarrage: les pages sont chargées à la première recherche.
+ */
+typedef struct snapshot_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t record_count;
+    uint64_t records_offset;
+    uint64_t index_capacity;
+    uint64_t index_offset;
+} SnapshotHeader;
+
+typedef struct snapshot_record
+{
+    char name[50];
+    char password[50];
+    uint8_t role;
+    uint8_t reserved[3];
+} SnapshotRecord;
+
+// Case de l'index: numéro d'enregistrement + 1 (0 si libre) et 32 bits bas du hash
+typedef struct snapshot_slot
+{
+    uint32_t record;
+    uint32_t hash;
+} SnapshotSlot;
+
+typedef struct snapshot
+{
+    void *base;
+    size_t size;
+    const SnapshotHeader *header;
+    const SnapshotRecord *records;
+    const SnapshotSlot *index;
+} Snapshot;
+
+typedef struct snapshot_writer
+{
+    FILE *file;
+    char path[256];
+    char temporary[260];
+    uint64_t *hashes;
+    size_t count;
+    size_t capacity;
+} SnapshotWriter;
+
+int snapshotOpen(Snapshot *snapshot, const char *path);
+const SnapshotRecord *snapshotFind(const Snapshot *snapshot, const char *name);
+size_t snapshotCount(const Snapshot *snapshot);
+void snapshotToUser(const SnapshotRecord *record, User *user);
+void snapshotClose(Snapshot *snapshot);
+
+int snapshotWriterOpen(SnapshotWriter *writer, const char *path);
+int snapshotWriterAdd(SnapshotWriter *writer, const User *user);
+int snapshotWriterCommit(SnapshotWriter *writer);
+void snapshotWriterAbort(SnapshotWriter *writer);
+
+#endif
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include "stats.h"
+#include "sendqueue.h"
+#include "config.h"
+
+ServerStats server_stats;
+
+/**
+ ** Writes a human readable report of the server counters.
+ * @param buffer (char*) - The destination buffer.
+ * @param size (size_t) - The size of the buffer.
+ * @returns void
+ */
+void statsFormat(char *buffer, size_t size)
+{
+    snprintf(buffer, size,
+             "Statistiques du serveur:\n"
+             "Files d'envoi: %zu octets en attente (limite globale %zu, par client %zu)\n"
+             "Politique clients lents: %s\n"
+             "Anciens broadcasts supprimés: %lu (%lu octets)\n"
+             "Nouveaux messages refusés: %lu (%lu octets)\n"
+             "Clients lents déconnectés: %lu\n"
+             "Transferts: %ld en cours, %ld en attente (%d workers, file de %d)\n"
+             "Transferts terminés: %lu, échoués: %lu, refusés: %lu\n"
+             "Octets transférés: %lu reçus, %lu envoyés\n"
+             "Journal des comptes: %lu enregistrements en %lu fdatasync, %lu compactions\n"
+             "Historique des salons: %ld messages, %ld octets (par salon: %d messages, %zu octets au plus)\n"
+             "Journal des messages: %lu enregistrements en %lu fdatasync (%lu perdus), %ld segments, %ld octets\n",
+             sendQueueTotalBytes(), server_config.global_queue_limit, server_config.queue_limit,
+             slowPolicyName(server_config.slow_policy),
+             atomic_load(&server_stats.dropped_oldest_messages), atomic_load(&server_stats.dropped_oldest_bytes),
+             atomic_load(&server_stats.dropped_new_messages), atomic_load(&server_stats.dropped_new_bytes),
+             atomic_load(&server_stats.slow_disconnects),
+             atomic_load(&server_stats.transfers_active), atomic_load(&server_stats.transfers_queued),
+             server_config.transfer_workers, server_config.transfer_queue,
+             atomic_load(&server_stats.transfers_completed), atomic_load(&server_stats.transfers_failed),
+             atomic_load(&server_stats.transfers_rejected),
+             atomic_load(&server_stats.transfer_bytes_received), atomic_load(&server_stats.transfer_bytes_sent),
+             atomic_load(&server_stats.wal_records), atomic_load(&server_stats.wal_commits),
+             atomic_load(&server_stats.wal_compactions),
+             atomic_load(&server_stats.history_messages), atomic_load(&server_stats.history_bytes),
+             server_config.history_size, server_config.history_bytes,
+             atomic_load(&server_stats.msglog_records), atomic_load(&server_stats.msglog_commits),
+             atomic_load(&server_stats.msglog_dropped),
+             atomic_load(&server_stats.msglog_segments), atomic_load(&server_stats.msglog_bytes));
+}
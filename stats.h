@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Compteurs du serveur, mis à jour sans verrou par tous les threads
+typedef struct server_stats
+{
+    atomic_ulong dropped_oldest_messages;
+    atomic_ulong dropped_oldest_bytes;
+    atomic_ulong dropped_new_messages;
+    atomic_ulong dropped_new_bytes;
+    atomic_ulong slow_disconnects;
+    atomic_long transfers_active;
+    atomic_long transfers_queued;
+    atomic_ulong transfers_completed;
+    atomic_ulong transfers_failed;
+    atomic_ulong transfers_rejected;
+    atomic_ulong transfer_bytes_received;
+    atomic_ulong transfer_bytes_sent;
+    atomic_ulong wal_records;
+    atomic_ulong wal_commits;
+    atomic_ulong wal_compactions;
+    atomic_long history_messages;
+    atomic_long history_bytes;
+    atomic_ulong msglog_records;
+    atomic_ulong msglog_commits;
+    atomic_ulong msglog_dropped;
+    atomic_long msglog_segments;
+    atomic_long msglog_bytes;
+} ServerStats;
+
+extern ServerStats server_stats;
+
+void statsFormat(char *buffer, size_t size);
+
+#endif
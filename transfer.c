@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/random.h>
+#include "transfer.h"
+#include "config.h"
+#include "stats.h"
+
+// Tâche en attente d'un worker
+typedef struct transfer_task
+{
+    void (*run)(void *);
+    void *arg;
+} TransferTask;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_ready = PTHREAD_COND_INITIALIZER;
+static TransferTask *tasks = NULL;
+static int task_head = 0;
+static int task_count = 0;
+
+static pthread_mutex_t offers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TransferOffer *offers = NULL;
+
+/**
+ ** Runs queued transfers until the process exits.
+ * @param arg (void*) - Unused.
+ * @returns void*
+ */
+static void *transferWorker(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&pool_mutex);
+        while (task_count == 0)
+            pthread_cond_wait(&pool_ready, &pool_mutex);
+
+        TransferTask task = tasks[task_head];
+        task_head = (task_head + 1) % server_config.transfer_queue;
+        task_count--;
+        atomic_fetch_sub(&server_stats.transfers_queued, 1);
+        atomic_fetch_add(&server_stats.transfers_active, 1);
+        pthread_mutex_unlock(&pool_mutex);
+
+        task.run(task.arg);
+        atomic_fetch_sub(&server_stats.transfers_active, 1);
+    }
+    return NULL;
+}
+
+/**
+ ** Starts the configured number of transfer workers.
+ * @returns int - 0 on success, -1 on error.
+ */
+int transferPoolStart(void)
+{
+    tasks = calloc(server_config.transfer_queue, sizeof(TransferTask));
+    offers = calloc(server_config.transfer_queue, sizeof(TransferOffer));
+
+    if (tasks == NULL || offers == NULL)
+    {
+        perror("calloc transfer pool");
+        return -1;
+    }
+
+    for (int i = 0; i < server_config.transfer_workers; i++)
+    {
+        pthread_t thread_id;
+
+        if (pthread_create(&thread_id, NULL, transferWorker, NULL) != 0)
+        {
+            perror("pthread_create transfer");
+            return -1;
+        }
+        pthread_detach(thread_id);
+    }
+    return 0;
+}
+
+/**
+ ** Queues a transfer for the worker pool. The queue is bounded: when it is full, the transfer is refused.
+ * @param run (void (*)(void*)) - The function running the transfer.
+ * @param arg (void*) - Its argument.
+ * @returns int - 0 if the transfer was queued, -1 if the queue is full.
+ */
+int transferPoolSubmit(void (*run)(void *), void *arg)
+{
+    pthread_mutex_lock(&pool_mutex);
+
+    if (task_count >= server_config.transfer_queue)
+    {
+        pthread_mutex_unlock(&pool_mutex);
+        atomic_fetch_add(&server_stats.transfers_rejected, 1);
+        return -1;
+    }
+
+    int slot = (task_head + task_count) % server_config.transfer_queue;
+    tasks[slot].run = run;
+    tasks[slot].arg = arg;
+    task_count++;
+    atomic_fetch_add(&server_stats.transfers_queued, 1);
+    pthread_cond_signal(&pool_ready);
+    pthread_mutex_unlock(&pool_mutex);
+    return 0;
+}
+
+/**
+ ** Records a transfer announced to a client and gives it a random one-time token.
+ * @param offer (TransferOffer*) - The transfer; its token and expiry date are filled in.
+ * @returns int - 0 on success, -1 if too many transfers are already waiting.
+ */
+int transferOffer(TransferOffer *offer)
+{
+    unsigned char random[(TRANSFER_TOKEN_SIZE - 1) / 2];
+
+    if (getrandom(random, sizeof(random), 0) != (ssize_t)sizeof(random))
+        return -1;
+
+    for (size_t i = 0; i < sizeof(random); i++)
+        sprintf(offer->token + 2 * i, "%02x", random[i]);
+
+    time_t now = time(NULL);
+    offer->expires = now + TRANSFER_OFFER_TTL;
+
+    pthread_mutex_lock(&offers_mutex);
+    for (int i = 0; i < server_config.transfer_queue; i++)
+    {
+        // Free slots and offers never claimed in time are reused
+        if (offers[i].token[0] == '\0' || offers[i].expires < now)
+        {
+            offers[i] = *offer;
+            pthread_mutex_unlock(&offers_mutex);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&offers_mutex);
+    atomic_fetch_add(&server_stats.transfers_rejected, 1);
+    return -1;
+}
+
+/**
+ ** Takes the transfer matching a token. A token can only be claimed once.
+ * @param token (const char*) - The token sent on the data connection.
+ * @param offer (TransferOffer*) - Receives the transfer.
+ * @returns int - 0 on success, -1 if the token is unknown or expired.
+ */
+int transferClaim(const char *token, TransferOffer *offer)
+{
+    time_t now = time(NULL);
+
+    if (token[0] == '\0')
+        return -1;
+
+    pthread_mutex_lock(&offers_mutex);
+    for (int i = 0; i < server_config.transfer_queue; i++)
+    {
+        if (strcmp(offers[i].token, token) == 0)
+        {
+            *offer = offers[i];
+            offers[i].token[0] = '\0';
+            pthread_mutex_unlock(&offers_mutex);
+            return offer->expires < now ? -1 : 0;
+        }
+    }
+    pthread_mutex_unlock(&offers_mutex);
+    return -1;
+}
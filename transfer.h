@@ -0,0 +1,34 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <time.h>
+
+#define TRANSFER_TOKEN_SIZE 33
+#define TRANSFER_OFFER_TTL 60
+
+/*
+ * Les transferts de fichiers des clients v2 passent par une connexion de données séparée:
+ *   1. le client envoie "@upload nom taille" ou "@download nom" sur sa connexion de chat;
+ *   2. le serveur répond "TRANSFER:<jeton>:<upload|download>:<nom>:<taille>";
+ *   3. le client ouvre une nouvelle connexion et envoie une trame FRAME_TRANSFER contenant le jeton;
+ *   4. un worker du pool échange les octets bruts sur cette connexion, le chat reste disponible.
+ */
+
+// Transfert annoncé à un client, en attente de sa connexion de données
+typedef struct transfer_offer
+{
+    char token[TRANSFER_TOKEN_SIZE];
+    int owner_fd;
+    char owner[100];
+    int is_upload;
+    char filename[256];
+    long size;
+    time_t expires;
+} TransferOffer;
+
+int transferPoolStart(void);
+int transferPoolSubmit(void (*run)(void *), void *arg);
+int transferOffer(TransferOffer *offer);
+int transferClaim(const char *token, TransferOffer *offer);
+
+#endif
@@ -1,63 +1,131 @@
 #include <stdio.h>
-#include <netinet/in.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
 #include <stdbool.h>
-#include <sys/stat.h>
+#include <fcntl.h>
 #include "ChainedList.h"
 #include "command.h"
 #include "user.h"
 #include "cJSON.h"
+#include "registry.h"
+#include "session.h"
+#include "epoch.h"
+#include "wal.h"
+#include "snapshot.h"
+#include "jsonstream.h"
+#include "arena.h"
 
 #define MAX_CLIENTS 10
 
-User *registered_users = NULL;
-pthread_mutex_t users_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Comptes chargés au démarrage: instantané projeté en mémoire, en lecture seule.
+// Le registre ne contient que les comptes créés depuis et ceux de l'instantané déjà utilisés,
+// recopiés à leur première recherche; users_mutex sérialise les sauvegardes.
+static Snapshot base_users;
+static Registry registered_users = REGISTRY_INITIALIZER;
+static pthread_mutex_t users_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Sérialise les changements de mot de passe: le journal les reçoit dans l'ordre où ils sont publiés
+static pthread_mutex_t password_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Réponse envoyée à un client une fois l'enregistrement correspondant écrit dans le journal
+typedef struct log_confirmation
+{
+    int socket_fd;
+    RegistryEntry *entry;
+    const char *message;
+    size_t length;
+} LogConfirmation;
 
 /**
- ** Finds a user by their username.
- * @param name (const char*) - The username to search for.
- * @returns User* - Pointer to the user struct, or NULL if not found.
+ ** Copies the current version of a registry entry's user.
+ * @param entry (RegistryEntry*) - The entry, or NULL.
+ * @param user (User*) - Receives the copy.
+ * @returns int - 0 on success, -1 if there is no entry.
  */
-User *findUserByName(const char *name)
+static int copyUser(RegistryEntry *entry, User *user)
 {
-    pthread_mutex_lock(&users_mutex);
-    User *current = registered_users;
-    while (current != NULL)
+    if (entry == NULL)
+        return -1;
+
+    epochEnter();
+    *user = *atomic_load(&entry->user);
+    epochExit();
+    return 0;
+}
+
+/**
+ ** Finds the registry entry of a user, copying the user from the snapshot on first use.
+ * @param name (const char*) - The username.
+ * @returns RegistryEntry* - The entry, or NULL if the user does not exist.
+ */
+static RegistryEntry *lookupEntry(const char *name)
+{
+    RegistryEntry *entry = registryFind(&registered_users, name);
+
+    if (entry != NULL)
+        return entry;
+
+    const SnapshotRecord *record = snapshotFind(&base_users, name);
+    User *user = record != NULL ? malloc(sizeof(User)) : NULL;
+
+    if (user == NULL)
+        return NULL;
+    snapshotToUser(record, user);
+
+    // Another thread may have copied the same user in the meantime: its entry wins
+    if (registryInsert(&registered_users, user, -1, &entry) != 0)
     {
-        if (strcmp(current->name, name) == 0)
-        {
-            pthread_mutex_unlock(&users_mutex);
-            return current;
-        }
-        current = current->next;
+        free(user);
+        entry = registryFind(&registered_users, name);
     }
-    pthread_mutex_unlock(&users_mutex);
-    return NULL;
+    return entry;
+}
+
+/**
+ ** Finds a user by their username.
+ * @param name (const char*) - The username to search for.
+ * @param user (User*) - Receives a copy of the user.
+ * @returns int - 0 if the user exists, -1 otherwise.
+ */
+int findUserByName(const char *name, User *user)
+{
+    RegistryEntry *entry = registryFind(&registered_users, name);
+
+    if (entry != NULL)
+        return copyUser(entry, user);
+
+    // A read does not need a registry entry
+    const SnapshotRecord *record = snapshotFind(&base_users, name);
+
+    if (record == NULL)
+        return -1;
+    snapshotToUser(record, user);
+    return 0;
 }
 
 /**
- ** Finds a user by their socket file descriptor.
+ ** Finds the user logged in on a socket, through the session table.
  * @param sock (int) - The socket file descriptor to search for.
- * @returns User* - Pointer to the user struct, or NULL if not found.
+ * @param user (User*) - Receives a copy of the user.
+ * @returns int - 0 if a user is logged in on the socket, -1 otherwise.
  */
-User *findUserBySocket(int sock)
+int findUserBySocket(int sock, User *user)
 {
-    pthread_mutex_lock(&users_mutex);
-    User *current = registered_users;
-    while (current != NULL)
-    {
-        if (current->socket_fd == sock)
-        {
-            pthread_mutex_unlock(&users_mutex);
-            return current;
-        }
-        current = current->next;
-    }
-    pthread_mutex_unlock(&users_mutex);
-    return NULL;
+    return copyUser(sessionEntry(sock), user);
+}
+
+/**
+ ** Finds the socket a user is logged in on.
+ * @param name (const char*) - The username.
+ * @returns int - The socket, or -1 if the user is unknown or not connected.
+ */
+int findUserSocket(const char *name)
+{
+    // Logged-in users always have an entry
+    RegistryEntry *entry = registryFind(&registered_users, name);
+
+    return entry != NULL ? atomic_load(&entry->socket_fd) : -1;
 }
 
 /**
@@ -67,12 +135,135 @@ User *findUserBySocket(int sock)
  */
 Role getRoleByName(const char *name)
 {
-    User *user = findUserByName(name);
-    if (user != NULL)
+    User user;
+
+    if (findUserByName(name, &user) == 0)
+        return user.role;
+    return USER;
+}
+
+/**
+ ** Checks a password and opens the session of the user on the socket.
+ * @param name (const char*) - The username.
+ * @param password (const char*) - The password given by the client.
+ * @param socket_fd (int) - The client socket.
+ * @returns int - 0 on success, 1 if the password is wrong, -1 if the user does not exist.
+ */
+int loginUser(const char *name, const char *password, int socket_fd)
+{
+    RegistryEntry *entry = lookupEntry(name);
+
+    if (entry == NULL)
+        return -1;
+
+    epochEnter();
+    int valid = strcmp(atomic_load(&entry->user)->password, password) == 0;
+    epochExit();
+
+    if (!valid)
+        return 1;
+    sessionOpen(socket_fd, entry);
+    return 0;
+}
+
+/**
+ ** Journal callback answering the client once its change is durable.
+ * @param arg (void*) - The LogConfirmation, freed here.
+ * @param status (int) - 0 if the record is on disk, -1 if it could not be written.
+ * @returns void
+ */
+static void confirmLogged(void *arg, int status)
+{
+    LogConfirmation *confirmation = (LogConfirmation *)arg;
+
+    // The client may have left, and its socket been reused, while the record was being written
+    if (sessionEntry(confirmation->socket_fd) == confirmation->entry)
     {
-        return user->role;
+        if (status == 0)
+            send_client_data(confirmation->socket_fd, confirmation->message, confirmation->length);
+        else
+            send_client_data(confirmation->socket_fd, "Erreur d'écriture du journal des comptes.\n", 44);
     }
-    return USER;
+    free(confirmation);
+}
+
+/**
+ ** Appends the new version of a user to the journal; the client gets its answer once the record is on disk.
+ * @param type (WalRecordType) - WAL_REGISTER or WAL_PASSWORD.
+ * @param user (const User*) - The new version of the user.
+ * @param socket_fd (int) - The client socket.
+ * @param entry (RegistryEntry*) - The registry entry of the user.
+ * @param message (const char*) - The answer sent once the record is durable.
+ * @param length (size_t) - Its length.
+ * @returns int - 0 on success, -1 if memory is exhausted.
+ */
+static int logUser(WalRecordType type, const User *user, int socket_fd, RegistryEntry *entry, const char *message, size_t length)
+{
+    WalRecord record = {0};
+    LogConfirmation *confirmation = malloc(sizeof(LogConfirmation));
+
+    if (confirmation == NULL)
+        return -1;
+
+    record.type = (uint8_t)type;
+    record.role = (uint8_t)user->role;
+    memcpy(record.name, user->name, sizeof(record.name));
+    memcpy(record.password, user->password, sizeof(record.password));
+    confirmation->socket_fd = socket_fd;
+    confirmation->entry = entry;
+    confirmation->message = message;
+    confirmation->length = length;
+
+    if (walAppend(&record, confirmLogged, confirmation) != 0)
+    {
+        free(confirmation);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ ** Changes the password of the user logged in on a socket, by publishing a new version of the user.
+ * The change is queued in the journal first, and only published if it was accepted.
+ * @param socket_fd (int) - The client socket.
+ * @param old_password (const char*) - The current password, as typed by the user.
+ * @param new_password (const char*) - The new password.
+ * The confirmation is sent to the client once the change is written in the journal.
+ * @returns int - 0 on success, 1 if the current password is wrong, -1 if nobody is logged in or memory is exhausted.
+ */
+int changePassword(int socket_fd, const char *old_password, const char *new_password)
+{
+    RegistryEntry *entry = sessionEntry(socket_fd);
+    User *replacement = malloc(sizeof(User));
+
+    if (entry == NULL || replacement == NULL)
+    {
+        free(replacement);
+        return -1;
+    }
+
+    int status = 1;
+
+    pthread_mutex_lock(&password_mutex);
+    epochEnter();
+
+    User *current = atomic_load(&entry->user);
+
+    if (strcmp(current->password, old_password) == 0)
+    {
+        *replacement = *current;
+        snprintf(replacement->password, sizeof(replacement->password), "%s", new_password);
+        status = logUser(WAL_PASSWORD, replacement, socket_fd, entry, "Mot de passe modifié.", 23);
+        // Published users only change under password_mutex: nothing can have replaced current
+        if (status == 0)
+            registryReplace(entry, current, replacement);
+    }
+    epochExit();
+    pthread_mutex_unlock(&password_mutex);
+
+    if (status != 0)
+        free(replacement);
+    return status;
 }
 
 /**
@@ -88,128 +279,300 @@ Role stringToRole(const char *roleStr)
 }
 
 /**
- ** Loads users from a JSON file into memory.
+ ** JSON stream callback adding one user to the registry.
+ * @param item (const cJSON*) - The user object.
+ * @param arg (void*) - Unused.
+ * @returns int - Always 0: an invalid user is skipped, not fatal.
+ */
+static int addUserFromJson(const cJSON *item, void *arg)
+{
+    const char *username = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "username"));
+    const char *password = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "password"));
+    const char *role = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "role"));
+    User *new_user;
+
+    (void)arg;
+    if (username == NULL || password == NULL || (new_user = calloc(1, sizeof(User))) == NULL)
+        return 0;
+
+    snprintf(new_user->name, sizeof(new_user->name), "%s", username);
+    snprintf(new_user->password, sizeof(new_user->password), "%s", password);
+    new_user->role = role != NULL ? stringToRole(role) : USER;
+
+    if (registryInsert(&registered_users, new_user, -1, NULL) != 0)
+        free(new_user);
+    return 0;
+}
+
+/**
+ ** Loads users from a JSON file into memory, streaming it one user at a time.
  * @param filename (const char*) - The path to the JSON file.
  * @returns void
  */
 void loadUsersFromJson(const char *filename)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
-    {
-        perror("Erreur ouverture JSON");
-        return;
-    }
-    struct stat st;
-    stat(filename, &st);
-    char *data = malloc(st.st_size + 1);
+    long count = jsonStreamArray(filename, addUserFromJson, NULL);
+
+    if (count >= 0)
+        printf("Import %s: %ld utilisateurs\n", filename, count);
+}
 
-    fread(data, 1, st.st_size, file);
-    data[st.st_size] = '\0';
-    fclose(file);
+// Parcours de tous les comptes: instantané et registre
+typedef struct user_visit
+{
+    void (*callback)(const User *user, void *arg);
+    void *arg;
+} UserVisit;
 
-    cJSON *json = cJSON_Parse(data);
+/**
+ ** Registry callback visiting the users that are not in the snapshot; the others are visited with it.
+ * @param user (User*) - The user.
+ * @param arg (void*) - The UserVisit.
+ * @returns void
+ */
+static void visitRegisteredUser(User *user, void *arg)
+{
+    UserVisit *visit = (UserVisit *)arg;
 
-    if (!json)
-    {
-        fprintf(stderr, "Erreur parsing JSON\n");
-        free(data);
-        return;
-    }
-    int count = cJSON_GetArraySize(json);
-    for (int i = 0; i < count; i++)
+    if (snapshotFind(&base_users, user->name) == NULL)
+        visit->callback(user, visit->arg);
+}
+
+/**
+ ** Calls a function once on the current version of every user, without blocking other threads.
+ * Whether a user belongs to the snapshot never changes, so each user is visited exactly once
+ * even while users are copied from the snapshot to the registry.
+ * @param callback (void (*)(const User*, void*)) - Called once per user.
+ * @param arg (void*) - Passed to the callback.
+ * @returns void
+ */
+static void forEachUser(void (*callback)(const User *user, void *arg), void *arg)
+{
+    UserVisit visit = {callback, arg};
+    size_t count = snapshotCount(&base_users);
+
+    for (size_t i = 0; i < count; i++)
     {
-        cJSON *item = cJSON_GetArrayItem(json, i);
-        const char *username = cJSON_GetObjectItem(item, "username")->valuestring;
-        const char *password = cJSON_GetObjectItem(item, "password")->valuestring;
-        const char *role = cJSON_GetObjectItem(item, "role")->valuestring;
-        User *new_user = malloc(sizeof(User));
-
-        strcpy(new_user->name, username);
-        strcpy(new_user->password, password);
-
-        new_user->role = stringToRole(role);
-        new_user->authenticated = false;
-        new_user->socket_fd = -1;
-        new_user->next = registered_users;
-        registered_users = new_user;
+        const SnapshotRecord *record = &base_users.records[i];
+        RegistryEntry *entry = registryFind(&registered_users, record->name);
+        User user;
+
+        // Users already copied to the registry may have changed since the snapshot
+        if (entry != NULL)
+            copyUser(entry, &user);
+        else
+            snapshotToUser(record, &user);
+        callback(&user, arg);
     }
-    cJSON_Delete(json);
-    free(data);
+    registryForEach(&registered_users, visitRegisteredUser, &visit);
 }
 
 /**
- ** Saves all users in memory to a JSON file.
- * @param filename (const char*) - The path to the JSON file.
+ ** Appends one user to a JSON array.
+ * @param user (const User*) - The user.
+ * @param arg (void*) - The cJSON array.
  * @returns void
  */
-void saveUsersToJson(const char *filename)
+static void addUserToJson(const User *user, void *arg)
+{
+    cJSON *json = (cJSON *)arg;
+    cJSON *user_obj = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(user_obj, "username", user->name);
+    cJSON_AddStringToObject(user_obj, "password", user->password);
+    cJSON_AddStringToObject(user_obj, "role", user->role == ADMIN ? "ADMIN" : "USER");
+    cJSON_AddItemToArray(json, user_obj);
+}
+
+/**
+ ** Saves all users in memory to a JSON file. The file is replaced atomically, and is durable on success.
+ * @param filename (const char*) - The path to the JSON file.
+ * @returns int - 0 on success, -1 on error.
+ */
+int saveUsersToJson(const char *filename)
 {
+    char temporary[256];
+    int status = -1;
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+
+    // Every node, string and print buffer comes from the arena and is released with it
+    Arena arena;
+
+    arenaInit(&arena);
     pthread_mutex_lock(&users_mutex);
+    arenaBegin(&arena);
     cJSON *json = cJSON_CreateArray();
-    User *current = registered_users;
 
-    while (current != NULL)
+    forEachUser(addUserToJson, json);
+
+    char *data = cJSON_Print(json);
+    FILE *file = data != NULL ? fopen(temporary, "w") : NULL;
+
+    if (file)
     {
-        cJSON *user_obj = cJSON_CreateObject();
+        int written = fputs(data, file) != EOF && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+        if (fclose(file) == 0 && written && rename(temporary, filename) == 0)
+            status = 0;
+        else
+            perror("Erreur écriture JSON");
+    }
+    arenaEnd();
+    pthread_mutex_unlock(&users_mutex);
+    arenaFree(&arena);
+    return status;
+}
+
+/**
+ ** Appends one user to the snapshot being written; stops adding after the first error.
+ * @param user (const User*) - The user.
+ * @param arg (void*) - The SnapshotWriter; its file is closed on error.
+ * @returns void
+ */
+static void addUserToSnapshot(const User *user, void *arg)
+{
+    SnapshotWriter *writer = (SnapshotWriter *)arg;
+
+    if (writer->file != NULL && snapshotWriterAdd(writer, user) != 0)
+        snapshotWriterAbort(writer);
+}
+
+/**
+ ** Writes the binary snapshot of every user. Also the journal callback replacing the rotated journal.
+ * @param arg (void*) - Unused.
+ * @returns int - 0 on success, -1 on error.
+ */
+static int snapshotUsers(void *arg)
+{
+    SnapshotWriter writer;
 
-        cJSON_AddStringToObject(user_obj, "username", current->name);
-        cJSON_AddStringToObject(user_obj, "password", current->password);
-        cJSON_AddStringToObject(user_obj, "role", current->role == ADMIN ? "ADMIN" : "USER");
-        cJSON_AddItemToArray(json, user_obj);
+    (void)arg;
+    if (snapshotWriterOpen(&writer, USERS_SNAPSHOT) != 0)
+        return -1;
 
-        current = current->next;
+    forEachUser(addUserToSnapshot, &writer);
+    if (writer.file == NULL)
+        return -1;
+    return snapshotWriterCommit(&writer);
+}
+
+/**
+ ** Loads the accounts: maps the binary snapshot, or imports the JSON file when there is none yet.
+ * Mapping the snapshot reads nothing, whatever the number of users; delete it to import users.json again.
+ * @returns int - 0 on success, -1 if the snapshot is damaged or cannot be created.
+ */
+int loadUsers(void)
+{
+    int status = snapshotOpen(&base_users, USERS_SNAPSHOT);
+
+    if (status == 0)
+    {
+        printf("Instantané %s: %zu utilisateurs\n", USERS_SNAPSHOT, snapshotCount(&base_users));
+        return 0;
+    }
+    if (status == -1)
+    {
+        fprintf(stderr, "Instantané %s invalide\n", USERS_SNAPSHOT);
+        return -1;
     }
 
-    char *data = cJSON_Print(json);
-    FILE *file = fopen(filename, "w");
+    loadUsersFromJson(USERS_FILE);
+    return snapshotUsers(NULL);
+}
 
-    if (file)
+/**
+ ** Journal callback applying a replayed record over the users loaded from the snapshot.
+ * @param record (const WalRecord*) - The record.
+ * @param arg (void*) - Unused.
+ * @returns void
+ */
+static void applyLogRecord(const WalRecord *record, void *arg)
+{
+    User *user = calloc(1, sizeof(User));
+
+    (void)arg;
+    if (user == NULL)
+        return;
+
+    memcpy(user->name, record->name, sizeof(user->name) - 1);
+    memcpy(user->password, record->password, sizeof(user->password) - 1);
+    user->role = record->role == ADMIN ? ADMIN : USER;
+
+    if (record->type == WAL_REGISTER)
     {
-        fputs(data, file);
-        fclose(file);
+        // Registered again after a snapshot that already holds them
+        if (snapshotFind(&base_users, user->name) != NULL || registryInsert(&registered_users, user, -1, NULL) != 0)
+            free(user);
+        return;
     }
-    free(data);
-    cJSON_Delete(json);
-    pthread_mutex_unlock(&users_mutex);
+
+    RegistryEntry *entry = lookupEntry(user->name);
+
+    // Replay is single-threaded: the version read cannot change before it is replaced
+    epochEnter();
+    if (entry == NULL || registryReplace(entry, atomic_load(&entry->user), user) != 0)
+        free(user);
+    epochExit();
+}
+
+/**
+ ** Replays the account journal over the users loaded from JSON, and starts logging changes.
+ * @returns int - 0 on success, -1 on error.
+ */
+int openUserLog(void)
+{
+    return walOpen(USERS_LOG, applyLogRecord, snapshotUsers, NULL);
+}
+
+/**
+ ** Writes the account changes still waiting in the journal, and closes it.
+ * @returns void
+ */
+void closeUserLog(void)
+{
+    walClose();
 }
 
 /**
- ** Registers a new user and adds them to the in-memory list.
+ ** Registers a new user and adds them to the registry.
  * @param username (const char*) - The username to register.
  * @param password (const char*) - The password for the user.
  * @param socketFd (int) - The socket file descriptor for the user.
- * @param addr (struct sockaddr_in) - The user's address.
  * @returns void
  */
-void registerUser(const char *username, const char *password, int socketFd, struct sockaddr_in addr)
+void registerUser(const char *username, const char *password, int socketFd)
 {
-    pthread_mutex_lock(&users_mutex);
-    User *existing = registered_users;
+    User *new_user = calloc(1, sizeof(User));
+    RegistryEntry *entry;
 
-    while (existing != NULL)
-    {
-        if (strcmp(existing->name, username) == 0)
-        {
-            pthread_mutex_unlock(&users_mutex);
-            send(socketFd, "Utilisateur déjà enregistré.\n", 33, 0);
-            return;
-        }
-        existing = existing->next;
-    }
-    User *new_user = malloc(sizeof(User));
+    if (new_user == NULL)
+        return;
 
-    strcpy(new_user->name, username);
-    strcpy(new_user->password, password);
+    snprintf(new_user->name, sizeof(new_user->name), "%s", username);
+    snprintf(new_user->password, sizeof(new_user->password), "%s", password);
 
     new_user->role = USER;
-    new_user->ad = addr;
-    new_user->socket_fd = socketFd;
-    new_user->authenticated = true;
-    new_user->next = registered_users;
-    registered_users = new_user;
 
-    pthread_mutex_unlock(&users_mutex);
-    saveUsersToJson("users.json");
-    send(socketFd, "Utilisateur enregistré avec succès.\n", 39, 0);
+    // Once published, the user may be replaced by a password change from another connection and
+    // retired: the epoch is entered before publishing, so that new_user stays readable until logged
+    epochEnter();
+
+    // The existence check and the insertion happen under the same registry lock;
+    // the snapshot never changes, so checking it first cannot race
+    if (snapshotFind(&base_users, new_user->name) != NULL || registryInsert(&registered_users, new_user, -1, &entry) != 0)
+    {
+        epochExit();
+        free(new_user);
+        send_client_data(socketFd, "Utilisateur déjà enregistré.\n", 33);
+        return;
+    }
+    sessionOpen(socketFd, entry);
+
+    // The confirmation waits until the account is durable; nothing is rewritten but one journal record
+    int logged = logUser(WAL_REGISTER, new_user, socketFd, entry, "Utilisateur enregistré avec succès.\n", 39);
+    epochExit();
+
+    if (logged != 0)
+        send_client_data(socketFd, "Erreur d'écriture du journal des comptes.\n", 44);
 }
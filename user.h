@@ -1,39 +1,45 @@
 #ifndef USER_H
 #define USER_H
 
-#include <netinet/in.h>
+#include <stddef.h>
 #include <stdbool.h>
 
-extern List *client_sockets;
-extern pthread_mutex_t clients_mutex;
-
 typedef enum
 {
     USER,
     ADMIN
 } Role;
 
+// Version d'un utilisateur: jamais modifiée une fois publiée dans le registre.
+// Un changement de mot de passe publie une nouvelle version (voir registry.h).
 typedef struct user
 {
     char name[50];
     char password[50];
     Role role;
-    struct sockaddr_in ad;
-    int socket_fd;
-    bool authenticated;
-    struct user *next;
 } User;
 
+#define USERS_FILE "users.json"
+#define USERS_LOG "users.log"
+#define USERS_SNAPSHOT "users.snap"
+
 void sendAllClients(const char *message);
+void send_client_data(int socket_fd, const void *data, size_t length);
 void sendClient(int socket_fd, const char *message);
 void removeClient(int socket_fd);
 void addClient(int sock);
 void *handleClient(void *arg);
-User *findUserByName(const char *name);
+int findUserByName(const char *name, User *user);
+int findUserSocket(const char *name);
 Role getRoleByName(const char *name);
-void registerUser(const char *pseudo, const char *password, int socket_fd, struct sockaddr_in ad);
-void saveUsersToJson(const char *filename);
+int loginUser(const char *name, const char *password, int socket_fd);
+void registerUser(const char *pseudo, const char *password, int socket_fd);
+int changePassword(int socket_fd, const char *old_password, const char *new_password);
+int saveUsersToJson(const char *filename);
+int loadUsers(void);
+int openUserLog(void);
+void closeUserLog(void);
 void loadUsersFromJson(const char *filename);
-User *findUserBySocket(int sock);
+int findUserBySocket(int sock, User *user);
 
 #endif
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "config.h"
+#include "stats.h"
+
+// Enregistrement en attente de validation
+typedef struct wal_pending
+{
+    WalRecord record;
+    WalDone done;
+    void *arg;
+    struct wal_pending *next;
+} WalPending;
+
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wal_ready = PTHREAD_COND_INITIALIZER;
+static WalPending *pending_head = NULL;
+static WalPending *pending_tail = NULL;
+static bool stopping = false;
+
+static pthread_mutex_t compaction_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compaction_ready = PTHREAD_COND_INITIALIZER;
+static int compaction_requested = 0;
+
+// Owned by the commit thread once the log is open
+static int log_fd = -1;
+static size_t log_records = 0;
+static atomic_bool rotated = false;
+static pthread_t commit_thread;
+
+static char log_path[256];
+static char rotated_path[256 + sizeof(WAL_ROTATED_SUFFIX)];
+static WalSnapshot snapshot_callback = NULL;
+static void *callback_arg = NULL;
+
+/**
+ ** Computes the CRC-32 of a record, over every byte after the checksum field.
+ * @param record (const WalRecord*) - The record.
+ * @returns uint32_t - The checksum.
+ */
+static uint32_t recordChecksum(const WalRecord *record)
+{
+    const unsigned char *bytes = (const unsigned char *)record + sizeof(record->checksum);
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < sizeof(WalRecord) - sizeof(record->checksum); i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+/**
+ ** Makes a rename or a file creation in the current directory durable.
+ * @returns void
+ */
+static void syncDirectory(void)
+{
+    int fd = open(".", O_RDONLY | O_DIRECTORY);
+
+    if (fd != -1)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ ** Applies every valid record of a log file. A torn or corrupted tail is cut off.
+ * @param path (const char*) - The log file.
+ * @param apply (WalApply) - Called for each record, in order.
+ * @param arg (void*) - Passed to apply.
+ * @returns size_t - The number of valid records.
+ */
+static size_t replayLog(const char *path, WalApply apply, void *arg)
+{
+    int fd = open(path, O_RDWR);
+
+    if (fd == -1)
+    {
+        if (errno != ENOENT)
+            perror("open journal");
+        return 0;
+    }
+
+    WalRecord record;
+    size_t count = 0;
+
+    while (read(fd, &record, sizeof(record)) == (ssize_t)sizeof(record) && record.checksum == recordChecksum(&record))
+    {
+        apply(&record, arg);
+        count++;
+    }
+
+    off_t valid = (off_t)(count * sizeof(WalRecord));
+    struct stat st;
+
+    // The end of the last commit may not have reached the disk before a crash
+    if (fstat(fd, &st) == 0 && st.st_size != valid)
+    {
+        fprintf(stderr, "Journal %s: %lld octets invalides ignorés\n", path, (long long)(st.st_size - valid));
+        if (ftruncate(fd, valid) != 0)
+            perror("ftruncate journal");
+    }
+    close(fd);
+    return count;
+}
+
+/**
+ ** Starts a new log file and asks the compaction thread to absorb the previous one.
+ * Called by the commit thread, the only one writing the log.
+ * @returns void
+ */
+static void rotateLog(void)
+{
+    if (rename(log_path, rotated_path) != 0)
+    {
+        perror("rename journal");
+        return;
+    }
+
+    int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+
+    if (fd == -1)
+    {
+        perror("open journal");
+        if (rename(rotated_path, log_path) != 0)
+            perror("rename journal");
+        return;
+    }
+    syncDirectory();
+    close(log_fd);
+    log_fd = fd;
+    log_records = 0;
+    atomic_store(&rotated, true);
+
+    pthread_mutex_lock(&compaction_mutex);
+    compaction_requested = 1;
+    pthread_cond_signal(&compaction_ready);
+    pthread_mutex_unlock(&compaction_mutex);
+}
+
+/**
+ ** Writes waiting records in batches: one write and one fdatasync per batch, then notifies the writers.
+ * Once the log is closed, it returns when nothing is left.
+ * @param arg (void*) - Unused.
+ * @returns void*
+ */
+static void *commitThread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&wal_mutex);
+        while (pending_head == NULL && !stopping)
+            pthread_cond_wait(&wal_ready, &wal_mutex);
+
+        WalPending *batch = pending_head;
+        pending_head = pending_tail = NULL;
+        pthread_mutex_unlock(&wal_mutex);
+
+        if (batch == NULL)
+            break;
+
+        size_t count = 0;
+
+        for (WalPending *current = batch; current != NULL; current = current->next)
+            count++;
+
+        WalRecord *records = malloc(count * sizeof(WalRecord));
+        int status = records != NULL ? 0 : -1;
+
+        if (records != NULL)
+        {
+            size_t i = 0;
+
+            for (WalPending *current = batch; current != NULL; current = current->next)
+                records[i++] = current->record;
+
+            size_t length = count * sizeof(WalRecord);
+            ssize_t written = write(log_fd, records, length);
+
+            if (written != (ssize_t)length || fdatasync(log_fd) != 0)
+            {
+                perror("écriture journal");
+                status = -1;
+                // A partial batch would be cut off at the next startup anyway
+                if (written > 0 && ftruncate(log_fd, (off_t)(log_records * sizeof(WalRecord))) != 0)
+                    perror("ftruncate journal");
+            }
+            else
+            {
+                log_records += count;
+                atomic_fetch_add(&server_stats.wal_records, count);
+                atomic_fetch_add(&server_stats.wal_commits, 1);
+            }
+            free(records);
+        }
+
+        while (batch != NULL)
+        {
+            WalPending *next = batch->next;
+
+            if (batch->done != NULL)
+                batch->done(batch->arg, status);
+            free(batch);
+            batch = next;
+        }
+
+        if (log_records >= (size_t)server_config.log_compact_records && !atomic_load(&rotated))
+            rotateLog();
+    }
+    return NULL;
+}
+
+/**
+ ** Writes snapshots on request and removes the log files they make useless.
+ * A failed snapshot is retried at the next request; until then the rotated log is kept.
+ * @param arg (void*) - Unused.
+ * @returns void*
+ */
+static void *compactionThread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&compaction_mutex);
+        while (!compaction_requested)
+            pthread_cond_wait(&compaction_ready, &compaction_mutex);
+        compaction_requested = 0;
+        pthread_mutex_unlock(&compaction_mutex);
+
+        // The snapshot holds at least everything in the rotated log: it can go once the snapshot is durable
+        if (snapshot_callback(callback_arg) == 0)
+        {
+            unlink(rotated_path);
+            syncDirectory();
+            atomic_fetch_add(&server_stats.wal_compactions, 1);
+            atomic_store(&rotated, false);
+        }
+    }
+    return NULL;
+}
+
+/**
+ ** Replays the log over the loaded snapshot, then opens it for appending and starts its threads.
+ * @param path (const char*) - The log file.
+ * @param apply (WalApply) - Applies a replayed record.
+ * @param snapshot (WalSnapshot) - Writes a durable snapshot of the current state; returns 0 on success.
+ * @param arg (void*) - Passed to apply and snapshot.
+ * @returns int - 0 on success, -1 on error.
+ */
+int walOpen(const char *path, WalApply apply, WalSnapshot snapshot, void *arg)
+{
+    snprintf(log_path, sizeof(log_path), "%s", path);
+    snprintf(rotated_path, sizeof(rotated_path), "%s%s", path, WAL_ROTATED_SUFFIX);
+    snapshot_callback = snapshot;
+    callback_arg = arg;
+
+    // A compaction interrupted by a stop left its log behind: it is older than the current one
+    size_t previous = replayLog(rotated_path, apply, arg);
+
+    log_records = replayLog(path, apply, arg);
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (log_fd == -1)
+    {
+        perror("open journal");
+        return -1;
+    }
+    if (access(rotated_path, F_OK) == 0)
+    {
+        atomic_store(&rotated, true);
+        compaction_requested = 1;
+    }
+    if (previous + log_records > 0)
+        printf("Journal: %zu enregistrements rejoués\n", previous + log_records);
+
+    // The compaction thread is not waited for: an interrupted compaction is taken up again at startup
+    pthread_t thread_id;
+
+    if (pthread_create(&commit_thread, NULL, commitThread, NULL) != 0 ||
+        pthread_create(&thread_id, NULL, compactionThread, NULL) != 0 || pthread_detach(thread_id) != 0)
+    {
+        perror("pthread_create journal");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ ** Writes the records still waiting, stops the commit thread and closes the log.
+ * Their writers are notified as usual; no record may be appended afterwards.
+ * @returns void
+ */
+void walClose(void)
+{
+    if (log_fd == -1)
+        return;
+
+    pthread_mutex_lock(&wal_mutex);
+    stopping = true;
+    pthread_cond_signal(&wal_ready);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_join(commit_thread, NULL);
+    close(log_fd);
+    log_fd = -1;
+}
+
+/**
+ ** Queues a record for the next group commit.
+ * @param record (const WalRecord*) - The record; its checksum is filled in here.
+ * @param done (WalDone) - Called by the commit thread once the record is durable (status 0) or lost (-1); may be NULL.
+ * @param arg (void*) - Passed to done.
+ * @returns int - 0 if the record was queued, -1 if memory is exhausted.
+ */
+int walAppend(const WalRecord *record, WalDone done, void *arg)
+{
+    WalPending *pending = malloc(sizeof(WalPending));
+
+    if (pending == NULL)
+        return -1;
+
+    pending->record = *record;
+    pending->record.checksum = recordChecksum(&pending->record);
+    pending->done = done;
+    pending->arg = arg;
+    pending->next = NULL;
+
+    pthread_mutex_lock(&wal_mutex);
+    if (pending_tail != NULL)
+        pending_tail->next = pending;
+    else
+        pending_head = pending;
+    pending_tail = pending;
+    pthread_cond_signal(&wal_ready);
+    pthread_mutex_unlock(&wal_mutex);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdint.h>
+
+#define WAL_ROTATED_SUFFIX ".1"
+
+typedef enum
+{
+    WAL_REGISTER = 1,
+    WAL_PASSWORD = 2,
+} WalRecordType;
+
+// Enregistrement du journal, de taille fixe et sans octet de remplissage: checksum couvre tous
+// les octets qui le suivent, les écrivains le remettent donc à zéro avant de le remplir.
+typedef struct wal_record
+{
+    uint32_t checksum;
+    uint8_t type;
+    uint8_t role;
+    char name[50];
+    char password[50];
+    char reserved[2];
+} WalRecord;
+
+/*
+ * Journal d'écriture anticipée des comptes utilisateurs.
+ * Les écrivains ajoutent un enregistrement et sont prévenus une fois qu'il est sur disque.
+ * Un thread de validation écrit d'un bloc tous les enregistrements en attente et les rend
+ * durables avec un seul fdatasync (validation groupée). Quand le journal dépasse le seuil
+ * configuré, il est renommé en <chemin>.1 et un thread de compaction écrit un instantané
+ * complet, après quoi l'ancien journal est supprimé. Au démarrage, <chemin>.1 puis <chemin>
+ * sont rejoués par-dessus l'instantané.
+ */
+
+typedef void (*WalApply)(const WalRecord *record, void *arg);
+typedef int (*WalSnapshot)(void *arg);
+typedef void (*WalDone)(void *arg, int status);
+
+int walOpen(const char *path, WalApply apply, WalSnapshot snapshot, void *arg);
+int walAppend(const WalRecord *record, WalDone done, void *arg);
+void walClose(void);
+
+#endif